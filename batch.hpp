@@ -0,0 +1,111 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "bfs.hpp"
+#include "common.h"
+#include "graph.hpp"
+
+// edges a thread of one query should cover before a second one pays off
+constexpr std::size_t kEdgesPerQueryThread = std::size_t(1) << 22;
+
+/**
+ * @brief Threads given to every traversal of a batch, the rest of the budget
+ * runs other traversals next to it. Small graphs get one thread per query,
+ * larger ones one per kEdgesPerQueryThread edges. num_threads is at least 1.
+ */
+inline int ThreadsPerQuery(std::size_t num_edges, int num_threads) {
+  const std::size_t wanted = num_edges / kEdgesPerQueryThread;
+  return int(std::clamp<std::size_t>(wanted, 1, num_threads));
+}
+
+/**
+ * @brief Keeps max-active-levels at 2 or more while alive. The setting belongs
+ * to the whole process, so guards alive at the same time share it: the first
+ * one saves the old value and the last one restores it, also when the scope
+ * is left by a throw.
+ */
+class NestedLevels {
+public:
+  NestedLevels() {
+    std::lock_guard lock(state().mutex);
+    if (state().holders++ != 0) return;
+    state().saved = omp_get_max_active_levels();
+    omp_set_max_active_levels(std::max(state().saved, 2));
+  }
+
+  NestedLevels(const NestedLevels &)            = delete;
+  NestedLevels &operator=(const NestedLevels &) = delete;
+  ~NestedLevels() {
+    std::lock_guard lock(state().mutex);
+    if (--state().holders == 0) omp_set_max_active_levels(state().saved);
+  }
+
+private:
+  struct State {
+    std::mutex mutex;
+    int        holders{0};
+    int        saved{1};
+  };
+
+  static State &state() {
+    static State shared;
+    return shared;
+  }
+};
+
+/**
+ * @brief Independent hybrid traversals from every source over the one shared,
+ * read-only graph. num_threads / threads_per_query workers take the sources
+ * one at a time, each in a nested region of threads_per_query threads with its
+ * own workspace and epoch-stamped solution, so after its first query a worker
+ * neither allocates nor resets anything. threads_per_query = 0 picks it from
+ * the graph size.
+ *
+ * on_result(i, sol) is called by the worker that traversed sources[i], sol is
+ * only valid during the call. It must not throw, an exception cannot leave the
+ * parallel region.
+ *
+ * The nested regions need max-active-levels of 2, a process-wide setting that
+ * a NestedLevels guard holds for the duration of the call. Returns false,
+ * without running anything, when num_threads < 1.
+ */
+template <Graph GraphT, typename OnResult>
+inline bool BfsBatch(const GraphT                                    &G,
+                     const std::vector<typename GraphT::vertex_type> &sources,
+                     int num_threads, int threads_per_query,
+                     OnResult &&on_result) {
+  if (num_threads < 1) return false;
+  if (threads_per_query <= 0)
+    threads_per_query = ThreadsPerQuery(G.num_edges, num_threads);
+  threads_per_query = std::min(threads_per_query, num_threads);
+
+  // no more workers than sources
+  const std::size_t num_sources = sources.size();
+  const int         num_workers = std::max<int>(
+      1, std::min<std::size_t>(num_threads / threads_per_query, num_sources));
+
+  const NestedLevels nested;
+#pragma omp parallel num_threads(num_workers)
+  {
+    // the kernels of this worker open regions of threads_per_query threads
+    omp_set_num_threads(threads_per_query);
+
+    SolutionOf<GraphT>  sol;
+    WorkspaceOf<GraphT> ws(G.get_num_nodes());
+    sol.stamped = true;
+
+#pragma omp for schedule(dynamic, 1)
+    for (std::size_t i = 0; i < num_sources; ++i) {
+      BfsHybrid(G, sources[i], sol, ws);
+      on_result(i, sol);
+    }
+  }
+
+  return true;
+}
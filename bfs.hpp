@@ -1,24 +1,78 @@
 #pragma once
 
 #include <omp.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <execution>
+#include <limits>
 #include <numeric>
+#include <ranges>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "common.h"
 #include "graph.hpp"
 
+// per-step timing logs, libbfs and bfs-server are built with BFS_NO_STEP_LOG
+#ifndef BFS_NO_STEP_LOG
 #define VERBOSE
-constexpr int NOT_VISITED = -1;
+#endif
+
+// edges per work item of an edge-partitioned top-down step
+constexpr std::size_t kEdgeChunk = 4096;
+
+/**
+ * @brief Parallel runtime of the step kernels: OpenMP loops, or TBB
+ * parallel_for with range splitting and work stealing. The conversions between
+ * steps run on OpenMP in both cases.
+ */
+enum class Backend { kOpenMP, kTbb };
+
+inline Backend BackendFromName(const std::string &name) {
+  if (name == "omp") return Backend::kOpenMP;
+  if (name == "tbb") return Backend::kTbb;
+  Error("unknown backend {}, expected omp|tbb", name);
+  exit(-1);
+}
+
+/**
+ * @brief One bit per vertex, the frontier and visited set of bottom-up steps
+ */
+struct Bitmap {
+  Bitmap() = default;
+  Bitmap(std::size_t n) : words((n + 63) / 64, 0) {}
+
+  FORCEINLINE bool get(std::size_t i) const {
+    return words[i / 64] >> (i % 64) & 1;
+  }
+
+  FORCEINLINE void set_atomic(std::size_t i) {
+    __sync_fetch_and_or(&words[i / 64], uint64_t(1) << (i % 64));
+  }
+
+  void clear() {
+    std::fill(std::execution::par_unseq, words.begin(), words.end(), 0);
+  }
+
+  std::vector<uint64_t> words;
+};
 
 /**
  * @brief A more memory-efficient frontier structure
  */
+template <typename VertexT>
 struct Frontier {
   Frontier() = default;
-  Frontier(int n) : data_ptr(std::make_shared<int[]>(n)) {
+  // left uninitialized, only the first size entries are ever read
+  Frontier(std::size_t n)
+      : data_ptr(std::make_shared_for_overwrite<VertexT[]>(n)) {
     data     = data_ptr.get();
     capacity = n;
   }
@@ -26,77 +80,274 @@ struct Frontier {
 
   FORCEINLINE bool empty() { return size == 0; }
   FORCEINLINE void clear() { size = 0; }
-  FORCEINLINE void push_back(const int v) { data[size++] = v; }
+  FORCEINLINE void push_back(const VertexT v) { data[size++] = v; }
 
-  std::shared_ptr<int[]> data_ptr;
-  int                   *data{nullptr};
-  std::size_t            size{0};
-  std::size_t            capacity{0};
+  std::shared_ptr<VertexT[]> data_ptr;
+  VertexT                   *data{nullptr};
+  std::size_t                size{0};
+  std::size_t                capacity{0};
 };
 
-inline std::size_t BfsTopDownStep(const Graph &G, Frontier *frontier,
-                                  Frontier *new_frontier, Frontier *frontiers,
-                                  Solution &sol) {
-  std::size_t num_checked_edges = 0;
-  auto       &distance          = sol.distance;
-  auto       &parent            = sol.parent;
-  const int   num_threads       = omp_get_max_threads();
-
-#pragma omp parallel for reduction(+ : num_checked_edges)
-  for (int i = 0; i < static_cast<int>(frontier->size); ++i) {
-    // thread local parameters
-    const int tid         = omp_get_thread_num();
-    Frontier &pt_frontier = frontiers[tid];
-    // expand each node in the previous frontier
-    const int  u  = frontier->data[i];
-    const int  du = distance[u];
-    const int *graph_start =
-        G.m_serial_graph.data() + G.m_serial_graph_start[u];
-
-    // TODO: for now directly use the iterator
-    num_checked_edges += G.get_num_edges(u);
-    for (int j = 0; j < static_cast<int>(G.get_num_edges(u)); ++j) {
-      const int v = graph_start[j];
-      if (distance[v] == NOT_VISITED &&
-          __sync_bool_compare_and_swap(&distance[v], NOT_VISITED, du + 1)) {
-        parent[v] = u;
-        pt_frontier.push_back(v);
-      }
+/**
+ * @brief Thread local block in front of a shared frontier. Vertices are
+ * flushed a whole block at a time, with one fetch_add to claim the space, so
+ * the per-thread memory does not grow with the graph.
+ */
+template <typename VertexT, std::size_t kBlockSize = 1024>
+struct FrontierBuffer {
+  FrontierBuffer(Frontier<VertexT> *shared) : shared(shared) {}
+  ~FrontierBuffer() { flush(); }
+
+  FORCEINLINE void push_back(const VertexT v) {
+    if (size == kBlockSize) flush();
+    block[size++] = v;
+  }
+
+  void flush() {
+    if (size == 0) return;
+    const std::size_t pos = __sync_fetch_and_add(&shared->size, size);
+    std::memcpy(shared->data + pos, block, size * sizeof(VertexT));
+    size = 0;
+  }
+
+  Frontier<VertexT> *shared;
+  VertexT            block[kBlockSize];
+  std::size_t        size{0};
+};
+
+template <typename GraphT>
+using FrontierOf = Frontier<typename GraphT::vertex_type>;
+template <typename GraphT>
+using SolutionOf = Solution<typename GraphT::vertex_type>;
+
+/**
+ * @brief Every frontier and bitmap of a traversal. It is sized once per graph
+ * and reused by all steps and by successive traversals, so repeated queries
+ * allocate nothing.
+ */
+template <typename VertexT>
+struct BfsWorkspace {
+  BfsWorkspace() = default;
+  BfsWorkspace(std::size_t n) { prepare(n); }
+
+  /**
+   * @brief Size the buffers for n vertices, a no-op when they already fit
+   */
+  void prepare(std::size_t n) {
+    if (n == num_nodes && frontier.data != nullptr) return;
+
+    num_nodes    = n;
+    frontier     = Frontier<VertexT>(n + 1);
+    new_frontier = Frontier<VertexT>(n + 1);
+    front        = Bitmap(n);
+    next         = Bitmap(n);
+    visited      = Bitmap(n);
+  }
+
+  Frontier<VertexT> frontier;
+  Frontier<VertexT> new_frontier;
+  Bitmap            front;  // bottom-up frontier
+  Bitmap            next;
+  Bitmap            visited;
+  std::size_t       num_nodes{0};
+
+  // degree prefix sum of the top-down frontier, grown on demand
+  std::vector<std::size_t> frontier_offsets;
+};
+
+template <typename GraphT>
+using WorkspaceOf = BfsWorkspace<typename GraphT::vertex_type>;
+
+/**
+ * @brief Reset sol for a traversal from source_node. Stamped solutions only
+ * move epoch past the distances of the last traversal, the O(n) fill is left
+ * for the first traversal and for when epoch would overflow.
+ */
+template <typename VertexT>
+inline void ResetSolution(std::size_t n, VertexT source_node,
+                          Solution<VertexT> &sol) {
+  const bool fits = sol.distance.size() == n &&
+                    sol.next_epoch <= std::numeric_limits<int>::max() - int(n);
+  if (sol.stamped && fits) {
+    sol.epoch = sol.next_epoch;
+  } else {
+    sol.distance.resize(n);
+    sol.parent.resize(n);
+    std::fill(sol.distance.begin(), sol.distance.end(), NOT_VISITED);
+    std::fill(sol.parent.begin(), sol.parent.end(), NOT_VISITED);
+    sol.epoch = 0;
+  }
+
+  sol.distance[source_node] = sol.epoch;
+  sol.parent[source_node]   = NOT_VISITED;
+}
+
+/**
+ * @brief Exclusive prefix sum of the frontier degrees into offsets, which gets
+ * frontier.size + 1 entries. Every thread scans a contiguous block, the block
+ * totals are then added in order.
+ *
+ * Called by every thread of a team, block_sums holds one entry per thread plus
+ * one and its first entry is 0. Returns after a barrier.
+ */
+template <Graph GraphT>
+inline void ScanDegreesInTeam(const GraphT             &G,
+                              const FrontierOf<GraphT> &frontier,
+                              std::size_t              *offsets,
+                              std::size_t              *block_sums) {
+  const std::size_t nf    = frontier.size;
+  const int         tid   = omp_get_thread_num();
+  const int         nt    = omp_get_num_threads();
+  const std::size_t first = nf * tid / nt;
+  const std::size_t last  = nf * (tid + 1) / nt;
+
+  std::size_t sum = 0;
+  for (std::size_t i = first; i < last; ++i) {
+    offsets[i] = sum;
+    sum += G.get_num_edges(frontier.data[i]);
+  }
+  block_sums[tid + 1] = sum;
+
+#pragma omp barrier
+#pragma omp single
+  std::partial_sum(block_sums, block_sums + nt + 1, block_sums);
+
+  for (std::size_t i = first; i < last; ++i) offsets[i] += block_sums[tid];
+
+#pragma omp single
+  offsets[nf] = block_sums[nt];
+}
+
+template <Graph GraphT>
+inline void ScanDegrees(const GraphT &G, const FrontierOf<GraphT> &frontier,
+                        std::size_t *offsets) {
+  std::vector<std::size_t> block_sums(omp_get_max_threads() + 1, 0);
+#pragma omp parallel
+  ScanDegreesInTeam(G, frontier, offsets, block_sums.data());
+}
+
+/**
+ * @brief Visit the edges [lo, hi) of the frontier, numbered by the degree
+ * prefix sum first_edge. Compressed lists are entered at lo through their
+ * checkpoints, graphs with neither random access nor seeking scan every list
+ * in the range where it starts.
+ */
+template <Graph GraphT>
+inline void ExpandEdges(const GraphT &G, const FrontierOf<GraphT> &frontier,
+                        const std::size_t *first_edge, std::size_t lo,
+                        std::size_t hi, SolutionOf<GraphT> &sol,
+                        FrontierBuffer<typename GraphT::vertex_type> &buffer) {
+  using vertex_type = typename GraphT::vertex_type;
+  using range_type  = decltype(G.neighbors(vertex_type()));
+
+  const std::size_t nf       = frontier.size;
+  auto             &distance = sol.distance;
+  auto             &parent   = sol.parent;
+
+  auto visit = [&](vertex_type u, vertex_type v, int du) {
+    const int dv = distance[v];
+    if (dv < sol.epoch &&
+        __sync_bool_compare_and_swap(&distance[v], dv, du + 1)) {
+      parent[v] = u;
+      buffer.push_back(v);
+    }
+  };
+
+  // the last frontier vertex whose edges start at or before lo
+  std::size_t i =
+      std::upper_bound(first_edge, first_edge + nf + 1, lo) - first_edge;
+  for (--i; i < nf && first_edge[i] < hi; ++i) {
+    const vertex_type u  = frontier.data[i];
+    const int         du = distance[u];
+    if constexpr (std::ranges::random_access_range<range_type>) {
+      // the part of the list inside [lo, hi)
+      const auto        neighbors = G.neighbors(u);
+      const std::size_t first     = std::max(lo, first_edge[i]);
+      const std::size_t last      = std::min(hi, first_edge[i + 1]);
+      for (std::size_t e = first; e < last; ++e)
+        visit(u, neighbors[e - first_edge[i]], du);
+    } else if constexpr (SeekableNeighbors<GraphT>) {
+      // decoded from the checkpoint at or before the part inside [lo, hi)
+      const std::size_t first     = std::max(lo, first_edge[i]);
+      const std::size_t last      = std::min(hi, first_edge[i + 1]);
+      const auto        neighbors = G.neighbors_from(u, first - first_edge[i]);
+      auto              it        = neighbors.begin();
+      for (std::size_t e = first; e < last; ++e, ++it) visit(u, *it, du);
+    } else {
+      if (first_edge[i] < lo) continue;
+      for (const vertex_type v : G.neighbors(u)) visit(u, v, du);
     }
   }
+}
 
-  for (int i = 0; i < num_threads; ++i) {
-    const Frontier &pt_frontier = frontiers[i];
-    std::memcpy(new_frontier->data + new_frontier->size, pt_frontier.data,
-                pt_frontier.size * sizeof(int));
-    new_frontier->size += pt_frontier.size;
+/**
+ * @brief Push step partitioned by edges instead of frontier vertices. The
+ * degree prefix sum of the frontier is cut into chunks of kEdgeChunk edges, so
+ * a hub is spread over many chunks rather than serializing the step on one
+ * thread.
+ *
+ * Every thread appends to new_frontier through its own FrontierBuffer.
+ */
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsTopDownStep(const GraphT &G, FrontierOf<GraphT> *frontier,
+                                  FrontierOf<GraphT>       *new_frontier,
+                                  std::vector<std::size_t> *offsets,
+                                  SolutionOf<GraphT>       &sol) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  // edges of frontier vertex i are [offsets[i], offsets[i + 1])
+  const std::size_t nf = frontier->size;
+  offsets->resize(nf + 1);
+  ScanDegrees(G, *frontier, offsets->data());
+
+  const std::size_t *first_edge        = offsets->data();
+  const std::size_t  num_checked_edges = first_edge[nf];
+  const std::size_t  num_chunks =
+      (num_checked_edges + kEdgeChunk - 1) / kEdgeChunk;
+
+  auto expand_chunk = [&](std::size_t c, FrontierBuffer<vertex_type> &buffer) {
+    const std::size_t lo = c * kEdgeChunk;
+    const std::size_t hi = std::min(lo + kEdgeChunk, num_checked_edges);
+    ExpandEdges(G, *frontier, first_edge, lo, hi, sol, buffer);
+  };
+
+  if constexpr (B == Backend::kTbb) {
+    // one buffer per stolen range, flushed when the range is done
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, num_chunks),
+                      [&](const tbb::blocked_range<std::size_t> &range) {
+                        FrontierBuffer<vertex_type> buffer(new_frontier);
+                        for (std::size_t c = range.begin(); c != range.end();
+                             ++c)
+                          expand_chunk(c, buffer);
+                      });
+  } else {
+#pragma omp parallel
+    {
+      FrontierBuffer<vertex_type> buffer(new_frontier);
+
+#pragma omp for schedule(dynamic, 1) nowait
+      for (std::size_t c = 0; c < num_chunks; ++c) expand_chunk(c, buffer);
+    }
   }
 
   return num_checked_edges;
 }
 
-inline std::size_t BfsTopDown(const Graph &G, int source_node, Solution &sol) {
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsTopDown(const GraphT &G,
+                              typename GraphT::vertex_type source_node,
+                              SolutionOf<GraphT>  &sol,
+                              WorkspaceOf<GraphT> &ws) {
   // init distance
-  auto &distance = sol.distance;
-  auto &parent   = sol.parent;
-  distance.resize(G.get_num_nodes());
-  parent.resize(G.get_num_nodes());
-  std::fill(distance.begin(), distance.end(), NOT_VISITED);
-  std::fill(parent.begin(), parent.end(), NOT_VISITED);
+  ResetSolution(G.get_num_nodes(), source_node, sol);
 
   // init frontier
-  Frontier *frontier, *new_frontier;
-  frontier     = new Frontier(G.get_num_nodes() + 1);
-  new_frontier = new Frontier(G.get_num_nodes() + 1);
-
-  const int num_threads = omp_get_max_threads();
-  Frontier  thread_frontiers[num_threads];
-  for (int i = 0; i < num_threads; ++i)
-    thread_frontiers[i] = Frontier(G.get_num_nodes());
+  ws.prepare(G.get_num_nodes());
+  FrontierOf<GraphT> *frontier     = &ws.frontier;
+  FrontierOf<GraphT> *new_frontier = &ws.new_frontier;
 
+  frontier->clear();
   frontier->push_back(source_node);
-  distance[source_node] = 0;
-
   std::size_t num_checked_edges = 0;
 
   int it = 0;
@@ -109,121 +360,337 @@ inline std::size_t BfsTopDown(const Graph &G, int source_node, Solution &sol) {
 #endif
 
     // The actual step
-    num_checked_edges +=
-        BfsTopDownStep(G, frontier, new_frontier, thread_frontiers, sol);
+    num_checked_edges += BfsTopDownStep<B>(G, frontier, new_frontier,
+                                           &ws.frontier_offsets, sol);
 
 #ifdef VERBOSE
     auto duration = top_down_step.end();
     Info("{}: {:.4f} {}", it, duration, num_checked_edges);
 #endif
 
-    for (int i = 0; i < num_threads; ++i) thread_frontiers[i].clear();
     // Swap frontiers
     std::swap(frontier, new_frontier);
     ++it;
   }
 
-  delete frontier;
-  delete new_frontier;
+  sol.next_epoch = sol.epoch + it + 1;
   return num_checked_edges;
 }
 
-inline int parallel_collect(int *select, int *out_indices, int n) {
-  int  num_not_visited = 0;
-  int *select_ps       = new int[n];
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsTopDown(const GraphT &G,
+                              typename GraphT::vertex_type source_node,
+                              SolutionOf<GraphT> &sol) {
+  WorkspaceOf<GraphT> ws;
+  return BfsTopDown<B>(G, source_node, sol, ws);
+}
 
-  std::exclusive_scan(std::execution::par, select, select + n, select_ps, 0);
-  num_not_visited = select_ps[n - 1] + select[n - 1];
+/**
+ * @brief Top-down traversal inside one parallel region, for high-diameter
+ * graphs where hundreds of levels would each pay the fork/join of the step
+ * regions. The team stays up from the source to the last level and only meets
+ * at barriers. A level of at most kSerialEdges edges is expanded by a single
+ * thread while the others wait at its barrier, larger ones are split into edge
+ * chunks as in BfsTopDownStep.
+ *
+ * Every decision shared by the team is made in a single block and written to
+ * the slot of the next level, so a thread still reading the current slot never
+ * sees it change. The region is OpenMP only, there is no TBB counterpart.
+ */
+template <Graph GraphT>
+inline std::size_t BfsTopDownPersistent(
+    const GraphT &G, typename GraphT::vertex_type source_node,
+    SolutionOf<GraphT> &sol, WorkspaceOf<GraphT> &ws) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  constexpr std::size_t kSerialEdges = 4 * kEdgeChunk;
+  auto                 &distance     = sol.distance;
+  auto                 &parent       = sol.parent;
+
+  ResetSolution(G.get_num_nodes(), source_node, sol);
+  ws.prepare(G.get_num_nodes());
+
+  // the frontier of level it is frontiers[it % 2]
+  FrontierOf<GraphT> *frontiers[2] = {&ws.frontier, &ws.new_frontier};
+  frontiers[0]->clear();
+  frontiers[0]->push_back(source_node);
+  frontiers[1]->clear();
+
+  struct Level {
+    std::size_t size;
+    std::size_t edges;  // exact for serial levels only
+    bool        serial;
+  };
+
+  auto plan_level = [&](const FrontierOf<GraphT> &frontier) {
+    Level level{frontier.size, 0, frontier.size <= kSerialEdges};
+    for (std::size_t i = 0; level.serial && i < frontier.size; ++i) {
+      level.edges += G.get_num_edges(frontier.data[i]);
+      level.serial = level.edges <= kSerialEdges;
+    }
+    return level;
+  };
+
+  auto expand_serial = [&](const FrontierOf<GraphT> &frontier,
+                           FrontierOf<GraphT>       *new_frontier) {
+    for (std::size_t i = 0; i < frontier.size; ++i) {
+      const vertex_type u  = frontier.data[i];
+      const int         du = distance[u];
+      for (const vertex_type v : G.neighbors(u)) {
+        if (distance[v] < sol.epoch) {
+          distance[v] = du + 1;
+          parent[v]   = u;
+          new_frontier->push_back(v);
+        }
+      }
+    }
+  };
+
+  Level                    levels[2] = {plan_level(*frontiers[0]), {}};
+  std::vector<std::size_t> block_sums(omp_get_max_threads() + 1, 0);
+  std::vector<std::size_t> &offsets           = ws.frontier_offsets;
+  std::size_t               num_checked_edges = 0;
+  int                       num_levels        = 0;
+  offsets.resize(levels[0].size + 1);
 
-#pragma omp parallel for schedule(dynamic, 128)
-  for (int i = 0; i < n; ++i) {
-    if (select[i] == 1) out_indices[select_ps[i]] = i;
+#ifdef VERBOSE
+  Event level_event;
+#endif
+
+  // run by one thread after level it, the team is past every read of it
+  auto finish_level = [&](int it, std::size_t level_edges) {
+    num_checked_edges += level_edges;
+    num_levels = it + 1;
+    frontiers[it % 2]->clear();
+
+    const Level next = plan_level(*frontiers[(it + 1) % 2]);
+    if (!next.serial) offsets.resize(next.size + 1);
+    levels[(it + 1) % 2] = next;
+
+#ifdef VERBOSE
+    Info("{}: {:.4f} {}", it, level_event.end(), num_checked_edges);
+    level_event = Event();
+#endif
+  };
+
+#pragma omp parallel
+  {
+    FrontierBuffer<vertex_type> buffer(nullptr);
+
+    for (int it = 0; levels[it % 2].size != 0; ++it) {
+      const Level         level        = levels[it % 2];
+      FrontierOf<GraphT> *frontier     = frontiers[it % 2];
+      FrontierOf<GraphT> *new_frontier = frontiers[(it + 1) % 2];
+
+      if (level.serial) {
+        // the rest of the team waits at the barrier of single
+#pragma omp single
+        {
+          expand_serial(*frontier, new_frontier);
+          finish_level(it, level.edges);
+        }
+      } else {
+        ScanDegreesInTeam(G, *frontier, offsets.data(), block_sums.data());
+
+        const std::size_t *first_edge = offsets.data();
+        const std::size_t  m_f        = first_edge[level.size];
+        const std::size_t  num_chunks = (m_f + kEdgeChunk - 1) / kEdgeChunk;
+
+        buffer.shared = new_frontier;
+#pragma omp for schedule(dynamic, 1) nowait
+        for (std::size_t c = 0; c < num_chunks; ++c) {
+          const std::size_t lo = c * kEdgeChunk;
+          const std::size_t hi = std::min(lo + kEdgeChunk, m_f);
+          ExpandEdges(G, *frontier, first_edge, lo, hi, sol, buffer);
+        }
+        buffer.flush();
+
+#pragma omp barrier
+#pragma omp single
+        finish_level(it, m_f);
+      }
+    }
   }
 
-  delete[] select_ps;
-  return num_not_visited;
+  sol.next_epoch = sol.epoch + num_levels + 1;
+  return num_checked_edges;
 }
 
-inline std::size_t BfsBottomUpStep(const Graph &G, Frontier *frontier,
-                                   Frontier *new_frontier, int it,
-                                   Solution &sol) {
-  std::size_t num_checked_edges = 0;
-  auto       &distance          = sol.distance;
-  auto       &parent            = sol.parent;
+template <Graph GraphT>
+inline std::size_t BfsTopDownPersistent(
+    const GraphT &G, typename GraphT::vertex_type source_node,
+    SolutionOf<GraphT> &sol) {
+  WorkspaceOf<GraphT> ws;
+  return BfsTopDownPersistent(G, source_node, sol, ws);
+}
 
-  int  num_not_visited     = 0;
-  int *mark_not_visited    = new int[G.get_num_nodes()];
-  int *not_visited_indices = new int[G.get_num_nodes()];
+/**
+ * @brief Queue to bitmap conversion when a traversal switches to bottom-up
+ */
+template <typename VertexT>
+inline void QueueToBitmap(const Frontier<VertexT> &queue, Bitmap *bitmap) {
+  bitmap->clear();
+#pragma omp parallel for
+  for (std::size_t i = 0; i < queue.size; ++i)
+    bitmap->set_atomic(queue.data[i]);
+}
 
-#pragma omp parallel for schedule(dynamic, 128)
-  for (int i = 0; i < G.get_num_nodes(); ++i) {
-    mark_not_visited[i] = distance[i] == NOT_VISITED ? 1 : 0;
+/**
+ * @brief Bitmap to queue conversion when a traversal switches back to
+ * top-down. Every thread takes a contiguous block of words, so the queue comes
+ * out sorted.
+ */
+template <typename VertexT>
+inline void BitmapToQueue(const Bitmap &bitmap, Frontier<VertexT> *queue) {
+  const std::size_t        num_words = bitmap.words.size();
+  std::vector<std::size_t> counts(omp_get_max_threads() + 1, 0);
+
+#pragma omp parallel
+  {
+    const int         tid   = omp_get_thread_num();
+    const int         nt    = omp_get_num_threads();
+    const std::size_t first = num_words * tid / nt;
+    const std::size_t last  = num_words * (tid + 1) / nt;
+
+    std::size_t count = 0;
+    for (std::size_t w = first; w < last; ++w)
+      count += __builtin_popcountll(bitmap.words[w]);
+    counts[tid + 1] = count;
+
+#pragma omp barrier
+#pragma omp single
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+
+    VertexT *out = queue->data + counts[tid];
+    for (std::size_t w = first; w < last; ++w) {
+      for (uint64_t bits = bitmap.words[w]; bits != 0; bits &= bits - 1)
+        *out++ = w * 64 + __builtin_ctzll(bits);
+    }
   }
 
-  num_not_visited = parallel_collect(mark_not_visited, not_visited_indices,
-                                     G.get_num_nodes());
-
-  int *select = new int[G.get_num_nodes()];
-  std::fill(select, select + G.get_num_nodes(), 0);
-
-  // collect all non-visited vertices
-#pragma omp parallel for schedule(dynamic, 128) reduction(+ : num_checked_edges)
-  for (int i = 0; i < num_not_visited; ++i) {
-    const int v = not_visited_indices[i];
-    assert(parent[v] == NOT_VISITED);
-    // bidirectional graph
-    const int *graph_start =
-        G.m_serial_graph.data() + G.m_serial_graph_start[v];
-    for (int j = 0; j < static_cast<int>(G.get_num_edges(v)); ++j) {
-      const int u = graph_start[j];
-      // last bfs layer
-      if (distance[u] == it) {
-        distance[v] = it + 1;
-        parent[v]   = u;
-        select[v]   = 1;
-        num_checked_edges += G.get_num_edges(v);
-        break;
-      }
+  queue->size = counts.back();
+}
+
+/**
+ * @brief Visited bitmap of the vertices reached so far, the bits past the last
+ * vertex are set so that bottom-up steps never look at them
+ */
+template <typename VertexT>
+inline void BuildVisited(const Solution<VertexT> &sol, Bitmap *visited) {
+  const std::size_t n = sol.distance.size();
+#pragma omp parallel for
+  for (std::size_t w = 0; w < visited->words.size(); ++w) {
+    uint64_t bits = 0;
+    for (std::size_t b = 0; b < 64; ++b) {
+      const std::size_t v = w * 64 + b;
+      if (v >= n || sol.visited(v)) bits |= uint64_t(1) << b;
     }
+    visited->words[w] = bits;
   }
+}
+
+/**
+ * @brief Pull step over the bitmaps: every vertex not yet visited scans its
+ * in-edges for a parent in front. A word of 64 vertices is owned by one
+ * iteration, so next and visited are written without atomics and whole words
+ * of visited vertices are skipped at once.
+ */
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsBottomUpStep(const GraphT &G, const Bitmap &front,
+                                   Bitmap *next, Bitmap *visited, int it,
+                                   std::size_t        *awake_count,
+                                   SolutionOf<GraphT> &sol) {
+  using vertex_type = typename GraphT::vertex_type;
 
-  new_frontier->size =
-      parallel_collect(select, new_frontier->data, G.get_num_nodes());
+  std::size_t num_checked_edges = 0;
+  std::size_t num_awake         = 0;
+  auto       &distance          = sol.distance;
+  auto       &parent            = sol.parent;
 
-  delete[] mark_not_visited;
-  delete[] not_visited_indices;
-  delete[] select;
+  // pull the unvisited vertices of word w, returns the checked edges
+  auto pull_word = [&](std::size_t w, std::size_t &num_awake) {
+    std::size_t checked = 0;
+    uint64_t    awake   = 0;
+    for (uint64_t bits = ~visited->words[w]; bits != 0; bits &= bits - 1) {
+      const int         b = __builtin_ctzll(bits);
+      const vertex_type v = w * 64 + b;
+      assert(!sol.visited(v));
+      // pull along the in-edges, the same as out-edges on undirected graphs
+      for (const vertex_type u : G.in_neighbors(v)) {
+        // last bfs layer
+        if (front.get(u)) {
+          distance[v] = sol.epoch + it + 1;
+          parent[v]   = u;
+          awake |= uint64_t(1) << b;
+          checked += G.get_num_in_edges(v);
+          break;
+        }
+      }
+    }
+
+    next->words[w] = awake;
+    visited->words[w] |= awake;
+    num_awake += __builtin_popcountll(awake);
+    return checked;
+  };
+
+  const std::size_t num_words = visited->words.size();
+  if constexpr (B == Backend::kTbb) {
+    using counts = std::pair<std::size_t, std::size_t>;  // checked, awake
+    const counts total = tbb::parallel_reduce(
+        tbb::blocked_range<std::size_t>(0, num_words, 64), counts(0, 0),
+        [&](const tbb::blocked_range<std::size_t> &range, counts sum) {
+          for (std::size_t w = range.begin(); w != range.end(); ++w)
+            sum.first += pull_word(w, sum.second);
+          return sum;
+        },
+        [](counts a, counts b) {
+          return counts(a.first + b.first, a.second + b.second);
+        });
+    num_checked_edges = total.first;
+    num_awake         = total.second;
+  } else {
+#pragma omp parallel for schedule(dynamic, 64) \
+    reduction(+ : num_checked_edges, num_awake)
+    for (std::size_t w = 0; w < num_words; ++w)
+      num_checked_edges += pull_word(w, num_awake);
+  }
+
+  *awake_count = num_awake;
   return num_checked_edges;
 }
 
-inline void BfsBottomUp(const Graph &G, int source_node, Solution &sol) {
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline void BfsBottomUp(const GraphT &G,
+                        typename GraphT::vertex_type source_node,
+                        SolutionOf<GraphT>  &sol,
+                        WorkspaceOf<GraphT> &ws) {
   // init distance
-  auto &distance = sol.distance;
-  auto &parent   = sol.parent;
-  distance.resize(G.get_num_nodes());
-  parent.resize(G.get_num_nodes());
-  std::fill(distance.begin(), distance.end(), NOT_VISITED);
-  std::fill(parent.begin(), parent.end(), NOT_VISITED);
-
-  Frontier *frontier, *new_frontier;
-  frontier     = new Frontier(G.get_num_nodes() + 1);
-  new_frontier = new Frontier(G.get_num_nodes() + 1);
+  ResetSolution(G.get_num_nodes(), source_node, sol);
 
-  frontier->push_back(source_node);
-  distance[source_node] = 0;
+  ws.prepare(G.get_num_nodes());
+  Bitmap &front   = ws.front;
+  Bitmap &next    = ws.next;
+  Bitmap &visited = ws.visited;
 
-  int it = 0;
-  while (!frontier->empty()) {
-    // traverse the frontier
-    new_frontier->clear();
+  front.clear();
+  front.set_atomic(source_node);
+  BuildVisited(sol, &visited);
 
+  std::size_t frontier_size = 1;
+  int         it            = 0;
+  while (frontier_size != 0) {
 #ifdef VERBOSE
     Event bottom_up_step;
 #endif
 
     // The actual step
+#ifdef VERBOSE
     auto num_checked_edges =
-        BfsBottomUpStep(G, frontier, new_frontier, it, sol);
+        BfsBottomUpStep<B>(G, front, &next, &visited, it, &frontier_size, sol);
+#else
+    BfsBottomUpStep<B>(G, front, &next, &visited, it, &frontier_size, sol);
+#endif
 
 #ifdef VERBOSE
     auto duration = bottom_up_step.end();
@@ -231,58 +698,67 @@ inline void BfsBottomUp(const Graph &G, int source_node, Solution &sol) {
 #endif
 
     // Swap frontiers
-    std::swap(frontier, new_frontier);
+    std::swap(front, next);
     ++it;
   }
 
-  delete frontier;
-  delete new_frontier;
+  sol.next_epoch = sol.epoch + it + 1;
+}
+
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline void BfsBottomUp(const GraphT &G,
+                        typename GraphT::vertex_type source_node,
+                        SolutionOf<GraphT> &sol) {
+  WorkspaceOf<GraphT> ws;
+  BfsBottomUp<B>(G, source_node, sol, ws);
 }
 
-inline std::size_t BfsHybrid(const Graph &G, int source_node, Solution &sol) {
+/**
+ * @brief m_f of a queue frontier, the number of edges its top-down step checks
+ */
+template <Graph GraphT>
+inline std::size_t FrontierEdges(const GraphT             &G,
+                                 const FrontierOf<GraphT> &frontier) {
+  std::size_t m_f = 0;
+#pragma omp parallel for reduction(+ : m_f)
+  for (std::size_t i = 0; i < frontier.size; ++i)
+    m_f += G.get_num_edges(frontier.data[i]);
+  return m_f;
+}
+
+/**
+ * @brief Direction-optimizing loop, resumed from the level it frontier held in
+ * ws.frontier. sol has to hold every vertex reached so far, num_checked_edges
+ * the edges scanned to reach them.
+ */
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsHybridFrom(const GraphT &G, SolutionOf<GraphT> &sol,
+                                 WorkspaceOf<GraphT> &ws, int it,
+                                 std::size_t num_checked_edges) {
   // https://scottbeamer.net/pubs/beamer-sc2012.pdf
   // m_f: number of edges from the frontier
   // n_f: number of vertices in the frontier
   // m_u: number of edges to check from unexplored vertices
+  FrontierOf<GraphT> *frontier     = &ws.frontier;
+  FrontierOf<GraphT> *new_frontier = &ws.new_frontier;
 
-  // init distance
-  auto &distance = sol.distance;
-  auto &parent   = sol.parent;
-  distance.resize(G.get_num_nodes());
-  parent.resize(G.get_num_nodes());
-  std::fill(distance.begin(), distance.end(), NOT_VISITED);
-  std::fill(parent.begin(), parent.end(), NOT_VISITED);
-
-  Frontier *frontier, *new_frontier;
-  frontier     = new Frontier(G.get_num_nodes() + 1);
-  new_frontier = new Frontier(G.get_num_nodes() + 1);
-
-  const int num_threads = omp_get_max_threads();
-  Frontier  thread_frontiers[num_threads];
-  for (int i = 0; i < num_threads; ++i)
-    thread_frontiers[i] = Frontier(G.get_num_nodes());
+  // bottom-up steps keep the frontier in front, as a bitmap
+  Bitmap &front   = ws.front;
+  Bitmap &next    = ws.next;
+  Bitmap &visited = ws.visited;
 
-  frontier->push_back(source_node);
-  distance[source_node]           = 0;
-  std::size_t   num_checked_edges = 0;
   constexpr int alpha = 14, beta = 24;  // from the paper
   bool          at_top_down = true;
 
-  int it = 0;
-  while (!frontier->empty()) {
-    // traverse the frontier
-    new_frontier->clear();
-
+  std::size_t n_f = frontier->size; /* number of vertices in frontier */
+  while (n_f != 0) {
     // Phase 1: collect all edges
     const auto num_edges = G.num_edges;
 
-    // Phase 2: summing all degrees in frontier
-    std::size_t n_f = frontier->size; /* number of vertices in frontier */
-    std::size_t m_f = 0;              /* number of edges to check */
+    // Phase 2: summing all degrees in frontier, only needed in top-down
+    std::size_t m_f = 0; /* number of edges to check */
     std::size_t m_u = num_edges - num_checked_edges;
-#pragma omp parallel for reduction(+ : m_f)
-    for (int i = 0; i < frontier->size; ++i)
-      m_f += G.get_num_edges(frontier->data[i]);
+    if (at_top_down) m_f = FrontierEdges(G, *frontier);
 
 #ifdef VERBOSE
     Event hybrid_step;
@@ -292,13 +768,16 @@ inline std::size_t BfsHybrid(const Graph &G, int source_node, Solution &sol) {
     if (at_top_down) {
       if (m_f > m_u / alpha) {
         at_top_down = false;
+        QueueToBitmap(*frontier, &front);
+        BuildVisited(sol, &visited);
         goto bottom_up_step;
       } else {
         goto top_down_step;
       }
     } else {
-      if (n_f < G.get_num_nodes() / beta) {
+      if (n_f < std::size_t(G.get_num_nodes() / beta)) {
         at_top_down = true;
+        BitmapToQueue(front, frontier);
         goto top_down_step;
       } else {
         goto bottom_up_step;
@@ -307,13 +786,16 @@ inline std::size_t BfsHybrid(const Graph &G, int source_node, Solution &sol) {
 
     // The actual step
 top_down_step:
-    num_checked_edges +=
-        BfsTopDownStep(G, frontier, new_frontier, thread_frontiers, sol);
-    for (int i = 0; i < num_threads; ++i) thread_frontiers[i].clear();
+    new_frontier->clear();
+    num_checked_edges += BfsTopDownStep<B>(G, frontier, new_frontier,
+                                           &ws.frontier_offsets, sol);
+    std::swap(frontier, new_frontier);
+    n_f = frontier->size;
     goto step_end;
 bottom_up_step:
-    // switch to bottom_up
-    num_checked_edges += BfsBottomUpStep(G, frontier, new_frontier, it, sol);
+    num_checked_edges +=
+        BfsBottomUpStep<B>(G, front, &next, &visited, it, &n_f, sol);
+    std::swap(front, next);
 step_end:
 
 #ifdef VERBOSE
@@ -321,12 +803,31 @@ step_end:
     Info("{} {}: {:.4f}", at_top_down ? "topdown" : "bottomup", it, duration);
 #endif
 
-    // Swap frontiers
-    std::swap(frontier, new_frontier);
     ++it;
   }
 
-  delete frontier;
-  delete new_frontier;
+  sol.next_epoch = sol.epoch + it + 1;
   return num_checked_edges;
+}
+
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsHybrid(const GraphT &G,
+                             typename GraphT::vertex_type source_node,
+                             SolutionOf<GraphT>  &sol,
+                             WorkspaceOf<GraphT> &ws) {
+  // init distance
+  ResetSolution(G.get_num_nodes(), source_node, sol);
+
+  ws.prepare(G.get_num_nodes());
+  ws.frontier.clear();
+  ws.frontier.push_back(source_node);
+  return BfsHybridFrom<B>(G, sol, ws, 0, 0);
+}
+
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline std::size_t BfsHybrid(const GraphT &G,
+                             typename GraphT::vertex_type source_node,
+                             SolutionOf<GraphT> &sol) {
+  WorkspaceOf<GraphT> ws;
+  return BfsHybrid<B>(G, source_node, sol, ws);
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "bfs.hpp"
+#include "common.h"
+#include "graph.hpp"
+
+/**
+ * @brief The two searches of a point-to-point query, each with a stamped
+ * solution and a workspace that every query reuses
+ */
+template <typename VertexT>
+struct BidirectionalWorkspace {
+  BidirectionalWorkspace() {
+    from_source.stamped = true;
+    from_target.stamped = true;
+  }
+
+  Solution<VertexT>     from_source;
+  Solution<VertexT>     from_target;  // depths and parents toward the target
+  BfsWorkspace<VertexT> forward;
+  BfsWorkspace<VertexT> backward;
+};
+
+template <typename GraphT>
+using BidirectionalWorkspaceOf =
+    BidirectionalWorkspace<typename GraphT::vertex_type>;
+
+template <typename VertexT>
+struct PathQuery {
+  int                  distance{NOT_VISITED};
+  std::size_t          num_checked_edges{0};
+  std::vector<VertexT> path;  // source to target, only filled on request
+};
+
+/**
+ * @brief A vertex of frontier that the other search reached too, -1 if there
+ * is none. The largest id is taken so that the answer does not depend on the
+ * thread count.
+ */
+template <typename VertexT>
+inline VertexT FindMeeting(const Frontier<VertexT> &frontier,
+                           const Solution<VertexT> &other) {
+  VertexT meeting = -1;
+#pragma omp parallel for reduction(max : meeting)
+  for (std::size_t i = 0; i < frontier.size; ++i) {
+    const VertexT v = frontier.data[i];
+    if (other.visited(v)) meeting = std::max(meeting, v);
+  }
+
+  return meeting;
+}
+
+/**
+ * @brief Distance from source to target, grown level by level from both ends.
+ * The side whose frontier has the smaller m_f is expanded, the backward one
+ * along the in-edges, and the search stops after the first level that reaches
+ * a vertex of the other side: every such vertex then lies on a shortest path.
+ * On small-world graphs the two balls stay far smaller than the component.
+ *
+ * with_path also fills the vertices of one shortest path.
+ */
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline PathQuery<typename GraphT::vertex_type> BfsBidirectional(
+    const GraphT &G, typename GraphT::vertex_type source,
+    typename GraphT::vertex_type target, BidirectionalWorkspaceOf<GraphT> &ws,
+    bool with_path = false) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  const std::size_t           n = G.get_num_nodes();
+  const TransposeView<GraphT> R(G);
+  auto                       &from_source = ws.from_source;
+  auto                       &from_target = ws.from_target;
+
+  ResetSolution(n, source, from_source);
+  ResetSolution(n, target, from_target);
+  ws.forward.prepare(n);
+  ws.backward.prepare(n);
+
+  FrontierOf<GraphT> *forward       = &ws.forward.frontier;
+  FrontierOf<GraphT> *forward_next  = &ws.forward.new_frontier;
+  FrontierOf<GraphT> *backward      = &ws.backward.frontier;
+  FrontierOf<GraphT> *backward_next = &ws.backward.new_frontier;
+  forward->clear();
+  forward->push_back(source);
+  backward->clear();
+  backward->push_back(target);
+
+  PathQuery<vertex_type> query;
+  std::size_t            m_forward      = G.get_num_edges(source);
+  std::size_t            m_backward     = R.get_num_edges(target);
+  int                    forward_depth  = 0;
+  int                    backward_depth = 0;
+
+  vertex_type meeting = source == target ? source : -1;
+  while (meeting < 0 && forward->size != 0 && backward->size != 0) {
+    if (m_forward <= m_backward) {
+      forward_next->clear();
+      query.num_checked_edges +=
+          BfsTopDownStep<B>(G, forward, forward_next,
+                            &ws.forward.frontier_offsets, from_source);
+      std::swap(forward, forward_next);
+      ++forward_depth;
+      m_forward = FrontierEdges(G, *forward);
+      meeting   = FindMeeting(*forward, from_target);
+    } else {
+      backward_next->clear();
+      query.num_checked_edges +=
+          BfsTopDownStep<B>(R, backward, backward_next,
+                            &ws.backward.frontier_offsets, from_target);
+      std::swap(backward, backward_next);
+      ++backward_depth;
+      m_backward = FrontierEdges(R, *backward);
+      meeting    = FindMeeting(*backward, from_source);
+    }
+  }
+
+  from_source.next_epoch = from_source.epoch + forward_depth + 1;
+  from_target.next_epoch = from_target.epoch + backward_depth + 1;
+  if (meeting < 0) return query;
+
+  query.distance = from_source.depth(meeting) + from_target.depth(meeting);
+  if (with_path) {
+    // parents lead back to source on one side and on to target on the other
+    vertex_type v = meeting;
+    while (v != NOT_VISITED) {
+      query.path.push_back(v);
+      v = from_source.parent_of(v);
+    }
+    std::reverse(query.path.begin(), query.path.end());
+
+    v = from_target.parent_of(meeting);
+    while (v != NOT_VISITED) {
+      query.path.push_back(v);
+      v = from_target.parent_of(v);
+    }
+  }
+
+  return query;
+}
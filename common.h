@@ -1,29 +1,51 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "spdlog/spdlog.h"
 
 #undef NDEBUG
 
-#define Info(...)              \
-  do {                         \
-    spdlog::info(__VA_ARGS__); \
-  } while (false)
+/**
+ * @brief Logger behind the logging macros. libbfs is built with BFS_NO_LOG and
+ * keeps a switched off logger of its own, so that it never writes through the
+ * default logger of the process that loads it.
+ */
+static inline spdlog::logger &BfsLogger() {
+#ifdef BFS_NO_LOG
+  static spdlog::logger logger = [] {
+    spdlog::logger quiet("libbfs");
+    quiet.set_level(spdlog::level::off);
+    return quiet;
+  }();
+  return logger;
+#else
+  return *spdlog::default_logger_raw();
+#endif
+}
 
-#define Warn(...)              \
-  do {                         \
-    spdlog::warn(__VA_ARGS__); \
+#define Info(...)                  \
+  do {                             \
+    BfsLogger().info(__VA_ARGS__); \
   } while (false)
 
-#define Critical(...)              \
+#define Warn(...)                  \
   do {                             \
-    spdlog::critical(__VA_ARGS__); \
+    BfsLogger().warn(__VA_ARGS__); \
   } while (false)
 
-#define Error(...)              \
-  do {                          \
-    spdlog::error(__VA_ARGS__); \
+#define Critical(...)                  \
+  do {                                 \
+    BfsLogger().critical(__VA_ARGS__); \
+  } while (false)
+
+#define Error(...)                  \
+  do {                              \
+    BfsLogger().error(__VA_ARGS__); \
   } while (false)
 
 #define FORCEINLINE __always_inline
@@ -48,7 +70,66 @@ private:
   decltype(clock::now()) m_start;
 };
 
+/**
+ * @brief Command line split into positional arguments and --key[=value]
+ * options
+ */
+struct Arguments {
+  Arguments(int argc, char **argv) {
+    for (int i = 0; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (!arg.starts_with("--")) {
+        positional.push_back(arg);
+        continue;
+      }
+
+      const auto eq = arg.find('=');
+      if (eq == std::string::npos) {
+        options[arg.substr(2)] = "";
+      } else {
+        options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+      }
+    }
+  }
+
+  bool has(const std::string &key) const { return options.contains(key); }
+
+  std::string get(const std::string &key, const std::string &value = "") const {
+    const auto it = options.find(key);
+    return it == options.end() ? value : it->second;
+  }
+
+  std::vector<std::string>           positional;
+  std::map<std::string, std::string> options;
+};
+
+constexpr int NOT_VISITED = -1;
+
+/**
+ * @brief Distances and BFS tree of one traversal
+ *
+ * Distances are stored offset by epoch, entries below it were left by earlier
+ * traversals and read as not visited. Plain solutions keep epoch at 0 and are
+ * filled with NOT_VISITED before every traversal, stamped ones move epoch past
+ * the previous traversal instead, so that repeated queries skip the reset.
+ */
+template <typename VertexT = int>
 struct Solution {
-  std::vector<int> distance;
-  std::vector<int> parent;
+  std::vector<int>     distance;
+  std::vector<VertexT> parent;
+  bool                 stamped{false};
+  int                  epoch{0};
+  int                  next_epoch{0};  // above every distance stored so far
+
+  FORCEINLINE bool visited(std::size_t v) const {
+    return distance[v] >= epoch;
+  }
+
+  FORCEINLINE int depth(std::size_t v) const {
+    return visited(v) ? distance[v] - epoch : NOT_VISITED;
+  }
+
+  FORCEINLINE VertexT parent_of(std::size_t v) const {
+    return visited(v) ? parent[v] : NOT_VISITED;
+  }
 };
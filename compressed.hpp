@@ -0,0 +1,525 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "graph.hpp"
+
+/**
+ * @brief LEB128 varint, 7 bits per byte with the high bit set on every byte
+ * but the last
+ */
+FORCEINLINE std::size_t VarintSize(uint64_t x) {
+  std::size_t size = 1;
+  while (x >= 0x80) {
+    x >>= 7;
+    ++size;
+  }
+
+  return size;
+}
+
+FORCEINLINE uint8_t *EncodeVarint(uint64_t x, uint8_t *p) {
+  while (x >= 0x80) {
+    *p++ = static_cast<uint8_t>(x) | 0x80;
+    x >>= 7;
+  }
+
+  *p++ = static_cast<uint8_t>(x);
+  return p;
+}
+
+FORCEINLINE const uint8_t *DecodeVarint(const uint8_t *p, uint64_t &x) {
+  // one byte covers most gaps of a well ordered graph
+  x = *p++;
+  if (x < 0x80) return p;
+  x &= 0x7f;
+  for (int shift = 7;; shift += 7) {
+    const uint64_t b = *p++;
+    x |= (b & 0x7f) << shift;
+    if (b < 0x80) return p;
+  }
+}
+
+/**
+ * @brief Signed deltas are zigzag mapped so that small magnitudes of either
+ * sign stay short
+ */
+FORCEINLINE uint64_t ZigzagEncode(int64_t x) {
+  return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+}
+
+FORCEINLINE int64_t ZigzagDecode(uint64_t x) {
+  return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1);
+}
+
+/**
+ * @brief Decoding iterator over one compressed neighbor list, compared against
+ * std::default_sentinel once the degree is exhausted
+ */
+template <typename VertexT>
+class NeighborIterator {
+public:
+  using iterator_concept = std::input_iterator_tag;
+  using value_type       = VertexT;
+  using difference_type  = std::ptrdiff_t;
+
+  NeighborIterator() = default;
+  NeighborIterator(const uint8_t *p, std::size_t degree, VertexT u)
+      : m_p(p), m_remaining(degree) {
+    if (m_remaining == 0) return;
+    uint64_t x;
+    m_p   = DecodeVarint(m_p, x);
+    m_cur = static_cast<int64_t>(u) + ZigzagDecode(x);
+  }
+
+  /**
+   * @brief Resume a list at a checkpoint, cur is the neighbor there and p the
+   * gap after it, remaining counts cur itself
+   */
+  NeighborIterator(const uint8_t *p, std::size_t remaining, int64_t cur)
+      : m_p(p), m_remaining(remaining), m_cur(cur) {}
+
+  FORCEINLINE VertexT operator*() const { return static_cast<VertexT>(m_cur); }
+
+  FORCEINLINE NeighborIterator &operator++() {
+    if (--m_remaining != 0) {
+      uint64_t gap;
+      m_p = DecodeVarint(m_p, gap);
+      m_cur += gap;
+    }
+
+    return *this;
+  }
+
+  FORCEINLINE NeighborIterator operator++(int) {
+    NeighborIterator it = *this;
+    ++*this;
+    return it;
+  }
+
+  FORCEINLINE bool operator==(std::default_sentinel_t) const {
+    return m_remaining == 0;
+  }
+
+private:
+  const uint8_t *m_p{nullptr};
+  std::size_t    m_remaining{0};
+  int64_t        m_cur{0};
+};
+
+template <typename VertexT>
+struct NeighborRange {
+  NeighborIterator<VertexT> first;
+
+  FORCEINLINE NeighborIterator<VertexT> begin() const { return first; }
+  FORCEINLINE std::default_sentinel_t   end() const { return {}; }
+};
+
+/**
+ * @brief Every kCheckpointStride-th neighbor of a long list is recorded with
+ * the byte offset of the gap after it, so that a list is entered anywhere
+ * after decoding fewer than kCheckpointStride gaps
+ */
+constexpr std::size_t kCheckpointStride = 128;
+
+/**
+ * @brief A checkpoint as stored in the byte stream, unaligned. Checkpoint t of
+ * a list holds its neighbor t * kCheckpointStride, t >= 1, and the offset of
+ * the gap after it from the first neighbor byte.
+ */
+struct Checkpoint {
+  uint32_t vertex;
+  uint32_t offset;
+};
+
+FORCEINLINE std::size_t NumCheckpoints(std::size_t degree) {
+  return degree == 0 ? 0 : (degree - 1) / kCheckpointStride;
+}
+
+/**
+ * @brief Bytes of the degree and the checkpoints ahead of the neighbors
+ */
+FORCEINLINE std::size_t ListHeaderSize(std::size_t degree) {
+  return VarintSize(degree) + NumCheckpoints(degree) * sizeof(Checkpoint);
+}
+
+/**
+ * @brief Byte stream of one compressed CSR. The list of u starts at
+ * offsets[u] with the varint degree, then NumCheckpoints(degree) checkpoints,
+ * then the first neighbor as a zigzag delta to u, then the gaps between
+ * consecutive sorted neighbors.
+ *
+ * bytes and offsets point either into the owned storage or into a mapped
+ * .cbin file.
+ */
+struct CompressedCsr {
+  CompressedCsr()                                 = default;
+  CompressedCsr(const CompressedCsr &)            = delete;
+  CompressedCsr &operator=(const CompressedCsr &) = delete;
+  CompressedCsr(CompressedCsr &&)                 = default;
+  CompressedCsr &operator=(CompressedCsr &&)      = default;
+
+  std::vector<uint8_t>  byte_storage;
+  std::vector<uint64_t> offset_storage;
+
+  const uint8_t  *bytes{nullptr};
+  const uint64_t *offsets{nullptr};  // num_nodes + 1 entries, in bytes
+  std::size_t     num_bytes{0};
+};
+
+/**
+ * @brief Read-only graph keeping every neighbor list sorted and delta + varint
+ * encoded, which trades a few ALU ops per edge for a fraction of the DRAM
+ * traffic of the plain CSR. The BFS kernels walk the lists through
+ * NeighborIterator, so the decode is fused into the traversal, and enter long
+ * lists at a checkpoint through neighbors_from to split them between threads.
+ *
+ * Built from a LocalGraph of any offset width, which can be released right
+ * after, or mapped from a .cbin file written by bfs-convert without any plain
+ * CSR in memory. Lists are located by 64-bit byte offsets either way.
+ */
+template <typename VertexT>
+class CompressedGraph {
+  // checkpoint offsets stay below 2^32 since the gaps of a list add up to
+  // less than the number of vertices
+  static_assert(sizeof(VertexT) <= sizeof(uint32_t));
+
+public:
+  using vertex_type = VertexT;
+  CompressedGraph() = default;
+
+  template <typename EdgeT>
+  explicit CompressedGraph(const LocalGraph<VertexT, EdgeT> &G)
+      : directed(G.directed), num_nodes(G.num_nodes), num_edges(G.num_edges) {
+    m_out = compress_csr(num_nodes, G.m_offsets, G.m_adj);
+    if (directed) m_in = compress_csr(num_nodes, G.m_in_offsets, G.m_in_adj);
+  }
+
+  /**
+   * @brief Two passes over the CSR behind the views: encoded size of every
+   * list, prefix sum, then encode each list at its offset
+   */
+  template <typename EdgeT>
+  static CompressedCsr compress_csr(std::size_t n, const EdgeT *offsets_view,
+                                    const VertexT *adj_view) {
+    CompressedCsr csr;
+    csr.offset_storage.resize(n + 1);
+
+    // sorted copies are only made for lists that are not sorted already
+    auto sorted_list = [&](std::size_t u, std::vector<VertexT> &buffer) {
+      const VertexT *first = adj_view + offsets_view[u];
+      const VertexT *last  = adj_view + offsets_view[u + 1];
+      if (std::is_sorted(first, last)) return first;
+      buffer.assign(first, last);
+      std::sort(buffer.begin(), buffer.end());
+      return static_cast<const VertexT *>(buffer.data());
+    };
+
+    std::vector<uint64_t> size(n + 1, 0);
+#pragma omp parallel
+    {
+      std::vector<VertexT> buffer;
+#pragma omp for schedule(dynamic, 64)
+      for (std::size_t u = 0; u < n; ++u) {
+        const std::size_t degree = offsets_view[u + 1] - offsets_view[u];
+        const VertexT    *list   = sorted_list(u, buffer);
+        size[u]                  = ListHeaderSize(degree);
+        if (degree == 0) continue;
+        size[u] += VarintSize(ZigzagEncode(int64_t(list[0]) - int64_t(u)));
+        for (std::size_t i = 1; i < degree; ++i)
+          size[u] += VarintSize(list[i] - list[i - 1]);
+      }
+    }
+
+    std::exclusive_scan(std::execution::par, size.begin(), size.end(),
+                        csr.offset_storage.begin(), uint64_t(0));
+
+    csr.num_bytes = csr.offset_storage[n];
+    csr.byte_storage.resize(csr.num_bytes);
+    csr.bytes   = csr.byte_storage.data();
+    csr.offsets = csr.offset_storage.data();
+#pragma omp parallel
+    {
+      std::vector<VertexT> buffer;
+#pragma omp for schedule(dynamic, 64)
+      for (std::size_t u = 0; u < n; ++u) {
+        const std::size_t degree = offsets_view[u + 1] - offsets_view[u];
+        const VertexT    *list   = sorted_list(u, buffer);
+        uint8_t          *p      = csr.byte_storage.data() + csr.offsets[u];
+        p                        = EncodeVarint(degree, p);
+        if (degree == 0) continue;
+
+        // the checkpoints are filled in as their neighbors are passed
+        uint8_t *checkpoints = p;
+        uint8_t *first       = p + NumCheckpoints(degree) * sizeof(Checkpoint);
+        p = EncodeVarint(ZigzagEncode(int64_t(list[0]) - int64_t(u)), first);
+        for (std::size_t i = 1; i < degree; ++i) {
+          p = EncodeVarint(list[i] - list[i - 1], p);
+          if (i % kCheckpointStride != 0) continue;
+          const Checkpoint checkpoint{uint32_t(list[i]), uint32_t(p - first)};
+          std::memcpy(checkpoints, &checkpoint, sizeof(checkpoint));
+          checkpoints += sizeof(checkpoint);
+        }
+      }
+    }
+
+    return csr;
+  }
+
+  FORCEINLINE VertexT get_num_nodes() const { return num_nodes; }
+
+  FORCEINLINE std::size_t get_num_edges(VertexT u) const {
+    return list_degree(m_out, u);
+  }
+
+  FORCEINLINE NeighborRange<VertexT> neighbors(VertexT u) const {
+    return list_range(m_out, u);
+  }
+
+  /**
+   * @brief In-edges of v, the same as the out-edges on undirected graphs
+   */
+  FORCEINLINE std::size_t get_num_in_edges(VertexT v) const {
+    return list_degree(directed ? m_in : m_out, v);
+  }
+
+  FORCEINLINE NeighborRange<VertexT> in_neighbors(VertexT v) const {
+    return list_range(directed ? m_in : m_out, v);
+  }
+
+  /**
+   * @brief The neighbors of u from the j-th one on, j < degree
+   */
+  FORCEINLINE NeighborRange<VertexT> neighbors_from(VertexT     u,
+                                                    std::size_t j) const {
+    return list_range_from(m_out, u, j);
+  }
+
+  FORCEINLINE NeighborRange<VertexT> in_neighbors_from(VertexT     v,
+                                                       std::size_t j) const {
+    return list_range_from(directed ? m_in : m_out, v, j);
+  }
+
+  /**
+   * @brief Bytes held by the encoded lists and their offsets
+   */
+  std::size_t memory_bytes() const {
+    const std::size_t num_offsets = num_nodes + 1;
+    auto csr_bytes = [num_offsets](const CompressedCsr &csr) {
+      return csr.num_bytes + num_offsets * sizeof(uint64_t);
+    };
+    return csr_bytes(m_out) + (directed ? csr_bytes(m_in) : 0);
+  }
+
+  CompressedCsr               m_out;
+  CompressedCsr               m_in;  // transpose, directed only
+  std::shared_ptr<MappedFile> m_mapping;
+
+  bool        directed{false};
+  std::size_t num_nodes{0};
+  std::size_t num_edges{0};
+
+private:
+  FORCEINLINE static std::size_t list_degree(const CompressedCsr &csr,
+                                             VertexT u) {
+    uint64_t degree;
+    DecodeVarint(csr.bytes + csr.offsets[u], degree);
+    return degree;
+  }
+
+  FORCEINLINE static NeighborRange<VertexT> list_range(const CompressedCsr &csr,
+                                                       VertexT u) {
+    uint64_t       degree;
+    const uint8_t *p = DecodeVarint(csr.bytes + csr.offsets[u], degree);
+    p += NumCheckpoints(degree) * sizeof(Checkpoint);
+    return {NeighborIterator<VertexT>(p, degree, u)};
+  }
+
+  /**
+   * @brief Start at the checkpoint at or before j, then decode up to j
+   */
+  FORCEINLINE static NeighborRange<VertexT> list_range_from(
+      const CompressedCsr &csr, VertexT u, std::size_t j) {
+    uint64_t       degree;
+    const uint8_t *p     = DecodeVarint(csr.bytes + csr.offsets[u], degree);
+    const uint8_t *first = p + NumCheckpoints(degree) * sizeof(Checkpoint);
+
+    NeighborIterator<VertexT> it;
+    const std::size_t         t = j / kCheckpointStride;
+    if (t == 0) {
+      it = NeighborIterator<VertexT>(first, degree, u);
+    } else {
+      Checkpoint checkpoint;
+      std::memcpy(&checkpoint, p + (t - 1) * sizeof(Checkpoint),
+                  sizeof(checkpoint));
+      it = NeighborIterator<VertexT>(first + checkpoint.offset,
+                                     degree - t * kCheckpointStride,
+                                     int64_t(checkpoint.vertex));
+    }
+
+    for (std::size_t i = t * kCheckpointStride; i < j; ++i) ++it;
+    return {it};
+  }
+};
+
+static_assert(SeekableNeighbors<CompressedGraph<int32_t>>);
+static_assert(SeekableNeighbors<TransposeView<CompressedGraph<int32_t>>>);
+
+/**
+ * @brief Bytes of the plain CSR arrays of G, to report the compression ratio
+ */
+template <typename VertexT, typename EdgeT>
+inline std::size_t CsrMemoryBytes(const LocalGraph<VertexT, EdgeT> &G) {
+  const std::size_t csr_bytes =
+      (G.num_nodes + 1) * sizeof(EdgeT) + G.num_edges * sizeof(VertexT);
+  return G.directed ? 2 * csr_bytes : csr_bytes;
+}
+
+/**
+ * @brief Compress G and log the size against the plain CSR
+ */
+template <typename VertexT, typename EdgeT>
+inline CompressedGraph<VertexT> CompressGraph(
+    const LocalGraph<VertexT, EdgeT> &G) {
+  Event                    compress_event;
+  CompressedGraph<VertexT> C(G);
+  const std::size_t        csr_bytes = CsrMemoryBytes(G);
+  Info("compress: {} -> {} bytes ({:.2f}x) in {:.4f} ms", csr_bytes,
+       C.memory_bytes(), double(csr_bytes) / C.memory_bytes(),
+       compress_event.end());
+  return C;
+}
+
+/**
+ * @brief On-disk compressed CSR layout (.cbin), version 2
+ *
+ * | header (64 bytes) | offsets[num_nodes + 1] | bytes[out_bytes] |
+ *
+ * Directed graphs (kDirected in flags) append the transposed lists in the
+ * same form, in_offsets then in_bytes[in_bytes]. Sections are 64-byte aligned
+ * as in the .bin layout, so that the mapped arrays are used in place. Version 2
+ * added the checkpoints of long lists.
+ */
+struct CompressedBinHeader {
+  static constexpr char     kMagic[8] = {'P', 'B', 'F', 'S', 'V', 'A', 'R', 0};
+  static constexpr uint32_t kVersion  = 2;
+  static constexpr uint32_t kDirected = 1u << 0;
+
+  char     magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t num_nodes;
+  uint64_t num_edges;
+  uint32_t vertex_bytes;
+  uint32_t reserved0;
+  uint64_t out_bytes;
+  uint64_t in_bytes;
+  uint64_t reserved;
+
+  uint64_t offsets_size() const { return (num_nodes + 1) * sizeof(uint64_t); }
+  uint64_t offsets_pos() const { return align(sizeof(CompressedBinHeader)); }
+  uint64_t bytes_pos() const { return align(offsets_pos() + offsets_size()); }
+  uint64_t in_offsets_pos() const { return align(bytes_pos() + out_bytes); }
+  uint64_t in_bytes_pos() const {
+    return align(in_offsets_pos() + offsets_size());
+  }
+
+  uint64_t file_size() const {
+    return flags & kDirected ? in_bytes_pos() + in_bytes
+                             : bytes_pos() + out_bytes;
+  }
+
+  static uint64_t align(uint64_t pos) { return BinGraphHeader::align(pos); }
+};
+static_assert(sizeof(CompressedBinHeader) == 64);
+
+template <typename VertexT>
+inline void CompressedGraphToBin(const std::string              &filename,
+                                 const CompressedGraph<VertexT> &C) {
+  Info("writing {}", filename);
+  CompressedBinHeader header{};
+  std::memcpy(header.magic, CompressedBinHeader::kMagic, sizeof(header.magic));
+  header.version      = CompressedBinHeader::kVersion;
+  header.flags        = C.directed ? CompressedBinHeader::kDirected : 0;
+  header.num_nodes    = C.num_nodes;
+  header.num_edges    = C.num_edges;
+  header.vertex_bytes = sizeof(VertexT);
+  header.out_bytes    = C.m_out.num_bytes;
+  header.in_bytes     = C.directed ? C.m_in.num_bytes : 0;
+
+  ReplacingFile file(filename);
+  auto write_csr = [&](uint64_t offsets_pos, uint64_t bytes_pos,
+                       const CompressedCsr &csr) {
+    file.pad_to(offsets_pos);
+    file.write(csr.offsets, header.offsets_size());
+    file.pad_to(bytes_pos);
+    file.write(csr.bytes, csr.num_bytes);
+  };
+
+  file.write(&header, sizeof(header));
+  write_csr(header.offsets_pos(), header.bytes_pos(), C.m_out);
+  if (C.directed)
+    write_csr(header.in_offsets_pos(), header.in_bytes_pos(), C.m_in);
+
+  file.commit();
+}
+
+/**
+ * @brief Map a .cbin file, the graph decodes the mapped lists in place
+ */
+template <typename VertexT>
+inline void CompressedGraphFromBin(const std::string        &filename,
+                                   CompressedGraph<VertexT> &C) {
+  Info("mapping {}", filename);
+  auto                mapping = std::make_shared<MappedFile>(filename);
+  CompressedBinHeader header;
+  if (mapping->size() < sizeof(header))
+    throw GraphFileError(fmt::format("{} is not a compressed graph", filename));
+
+  std::memcpy(&header, mapping->data(), sizeof(header));
+  if (std::memcmp(header.magic, CompressedBinHeader::kMagic,
+                  sizeof(header.magic)) != 0 ||
+      header.version != CompressedBinHeader::kVersion)
+    throw GraphFileError(
+        fmt::format("{}: bad magic or unsupported version", filename));
+  if (header.vertex_bytes != sizeof(VertexT) ||
+      header.num_nodes >= uint64_t(std::numeric_limits<VertexT>::max()) ||
+      header.file_size() > mapping->size())
+    throw GraphFileError(
+        fmt::format("{}: layout does not match the graph type", filename));
+
+  // the last offset closes the byte stream of every list
+  auto bind = [&](uint64_t offsets_pos, uint64_t bytes_pos, uint64_t size) {
+    const char   *base = mapping->data();
+    CompressedCsr csr;
+    csr.offsets   = reinterpret_cast<const uint64_t *>(base + offsets_pos);
+    csr.bytes     = reinterpret_cast<const uint8_t *>(base + bytes_pos);
+    csr.num_bytes = size;
+    if (csr.offsets[header.num_nodes] != size)
+      throw GraphFileError(fmt::format("{}: truncated lists", filename));
+    return csr;
+  };
+
+  C           = CompressedGraph<VertexT>();
+  C.directed  = header.flags & CompressedBinHeader::kDirected;
+  C.num_nodes = header.num_nodes;
+  C.num_edges = header.num_edges;
+
+  C.m_out = bind(header.offsets_pos(), header.bytes_pos(), header.out_bytes);
+  if (C.directed)
+    C.m_in = bind(header.in_offsets_pos(), header.in_bytes_pos(),
+                  header.in_bytes);
+  C.m_mapping = std::move(mapping);
+}
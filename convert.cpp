@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "compressed.hpp"
+#include "graph.hpp"
+
+#undef NDEBUG
+
+using raw_edge_list = std::vector<std::pair<uint64_t, uint64_t>>;
+using edge_list     = SmallGraph::edge_list;
+
+/**
+ * @brief Write G as a plain .bin or, by the suffix of filename, as a
+ * compressed .cbin. The plain CSR is released before the compressed one is
+ * written.
+ */
+template <typename GraphT>
+void WriteGraphFile(const std::string &filename, GraphT &G) {
+  if (!filename.ends_with(".cbin")) {
+    GraphToBin(filename, G);
+    return;
+  }
+
+  const auto C = CompressGraph(G);
+  G            = GraphT();
+  CompressedGraphToBin(filename, C);
+}
+
+/**
+ * @brief Compress a .bin file into a .cbin one. The plain CSR is only mapped,
+ * so its pages stay in the page cache instead of the heap.
+ */
+template <typename GraphT>
+void CompressBin(const Arguments &args) {
+  GraphT G;
+  GraphFromBin(args.positional[1], G);
+  WriteGraphFile(args.positional[2], G);
+}
+
+template <typename GraphT>
+void WriteGraph(const std::vector<edge_list> &chunks, std::size_t n,
+                const Arguments &args) {
+  GraphT G;
+  G.directed = !args.has("symmetrize");
+  G.build(n, chunks.size(), [&chunks](int c, auto &&f) {
+    for (const auto &[u, v] : chunks[c]) f(u, v);
+  });
+
+  if (args.has("dedup")) {
+    const auto removed = G.deduplicate();
+    Info("dedup: removed {} duplicate edges", removed);
+  }
+
+  Info("num_nodes: {}", G.get_num_nodes());
+  Info("num_edges: {}", G.num_edges);
+  WriteGraphFile(args.positional[2], G);
+}
+
+void Convert(const Arguments &args) {
+  const auto &filename = args.positional[1];
+  if (filename.ends_with(".bin")) {
+    if (GraphNeedsLargeOffsets(filename)) {
+      CompressBin<LargeGraph>(args);
+    } else {
+      CompressBin<SmallGraph>(args);
+    }
+    return;
+  }
+
+  Info("reading {}", filename);
+  MappedFile file(filename);
+  file.advise(MADV_SEQUENTIAL);
+
+  // Phase 1: tokenize the edge list in parallel chunks
+  const int  num_chunks = omp_get_max_threads() * 4;
+  const auto bounds =
+      SplitLines(file.data(), file.data() + file.size(), num_chunks);
+  std::vector<raw_edge_list> raw_chunks(num_chunks);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < num_chunks; ++c) {
+    ForEachEdgeLine(bounds[c], bounds[c + 1], '#',
+                    [&chunk = raw_chunks[c]](uint64_t u, uint64_t v) {
+                      chunk.emplace_back(u, v);
+                    });
+  }
+
+  std::vector<std::size_t> chunk_start(num_chunks + 1, 0);
+  for (int c = 0; c < num_chunks; ++c)
+    chunk_start[c + 1] = chunk_start[c] + raw_chunks[c].size();
+  const std::size_t num_raw_edges = chunk_start[num_chunks];
+  Info("read {} edges", num_raw_edges);
+
+  // Phase 2: sort and unique all endpoints, dense ids are the ranks
+  std::vector<uint64_t> ids(num_raw_edges * 2);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < num_chunks; ++c) {
+    uint64_t *out = ids.data() + chunk_start[c] * 2;
+    for (const auto &[u, v] : raw_chunks[c]) {
+      *out++ = u;
+      *out++ = v;
+    }
+  }
+
+  std::sort(std::execution::par, ids.begin(), ids.end());
+  ids.erase(std::unique(std::execution::par, ids.begin(), ids.end()),
+            ids.end());
+  ids.shrink_to_fit();
+  if (ids.size() > static_cast<std::size_t>(
+                       std::numeric_limits<SmallGraph::vertex_type>::max())) {
+    Error("{} vertices do not fit the vertex id type", ids.size());
+    exit(-1);
+  }
+
+  Info("compacted {} vertex ids", ids.size());
+
+  // Phase 3: remap the edges chunk by chunk, freeing the raw ids on the way
+  std::vector<edge_list> chunks(num_chunks);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < num_chunks; ++c) {
+    auto rank = [&ids](uint64_t id) {
+      return std::lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+    };
+
+    chunks[c].reserve(raw_chunks[c].size());
+    for (const auto &[u, v] : raw_chunks[c])
+      chunks[c].emplace_back(rank(u), rank(v));
+    raw_edge_list().swap(raw_chunks[c]);
+  }
+
+  const auto       &out_filename = args.positional[2];
+  const std::string ids_filename =
+      out_filename.substr(0, out_filename.rfind('.')) + ".ids";
+  WriteIdMap(ids_filename, ids);
+
+  // Phase 4: CSR construction, 64-bit offsets only when 32 bits may overflow
+  const std::size_t max_edges =
+      args.has("symmetrize") ? num_raw_edges * 2 : num_raw_edges;
+  if (max_edges > std::numeric_limits<uint32_t>::max()) {
+    WriteGraph<LargeGraph>(chunks, ids.size(), args);
+  } else {
+    WriteGraph<SmallGraph>(chunks, ids.size(), args);
+  }
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_pattern("\% %v");
+
+  const Arguments args(argc, argv);
+  const bool compressed =
+      args.positional.size() == 3 && args.positional[2].ends_with(".cbin");
+  const bool plain =
+      args.positional.size() == 3 && args.positional[2].ends_with(".bin");
+  if (!(compressed || (plain && !args.positional[1].ends_with(".bin")))) {
+    Error(
+        "bfs-convert [edge_list].txt [out_graph].[bin|cbin] [--symmetrize] "
+        "[--dedup], or bfs-convert [graph].bin [out_graph].cbin");
+    exit(-1);
+  }
+
+  try {
+    Convert(args);
+  } catch (const GraphFileError &e) {
+    Error("{}", e.what());
+    exit(-1);
+  }
+}
@@ -5,162 +5,793 @@
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/graph_utility.hpp>
 // clang-format on
+#include <omp.h>
+
+#include <algorithm>
+#include <concepts>
 #include <cstdlib>
+#include <cstring>
+#include <execution>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "common.h"
+#include "io.hpp"
 
-class BaseGraph {
-public:
-  virtual ~BaseGraph()                                   = default;
-  FORCEINLINE virtual void        add_edge(int u, int v) = 0;
-  FORCEINLINE virtual int         get_num_nodes() const  = 0;
-  FORCEINLINE virtual int         get_edge(int u, std::size_t i) const = 0;
-  FORCEINLINE virtual std::size_t get_num_edges(int u) const           = 0;
+/**
+ * @brief Interface of the graphs the BFS kernels run on. The kernels are
+ * templates over it, so neighbor iteration is inlined for every layout instead
+ * of going through a virtual call.
+ *
+ * neighbors(u) and in_neighbors(v) are input ranges over the out- and in-edges
+ * respectively, yielding ids convertible to vertex_type. num_edges is the
+ * number of stored directed edges.
+ */
+template <typename GraphT>
+concept Graph = requires(const GraphT &G, typename GraphT::vertex_type u) {
+  typename GraphT::vertex_type;
+  { G.get_num_nodes() } -> std::convertible_to<typename GraphT::vertex_type>;
+  { G.get_num_edges(u) } -> std::convertible_to<std::size_t>;
+  { G.get_num_in_edges(u) } -> std::convertible_to<std::size_t>;
+  { G.num_edges } -> std::convertible_to<std::size_t>;
+  requires std::ranges::input_range<decltype(G.neighbors(u))>;
+  requires std::ranges::input_range<decltype(G.in_neighbors(u))>;
+  requires std::convertible_to<
+      std::ranges::range_reference_t<decltype(G.neighbors(u))>,
+      typename GraphT::vertex_type>;
 };
 
+/**
+ * @brief Graphs whose neighbor lists cannot be indexed but can be entered at
+ * the j-th neighbor in a bounded number of steps, e.g. compressed lists with
+ * checkpoints
+ */
+template <typename GraphT>
+concept SeekableNeighbors =
+    Graph<GraphT> &&
+    requires(const GraphT &G, typename GraphT::vertex_type u, std::size_t j) {
+      requires std::ranges::input_range<decltype(G.neighbors_from(u, j))>;
+    };
+
 /**
  * @brief Naive graph implementation for quick traversal
+ *
+ * The CSR arrays are accessed through raw views, which point either into the
+ * owned vectors (graphs built from text files) or into a mapped binary file.
+ * Edges added through add_edge are staged in a flat edge array and turned into
+ * the CSR by post_processing. Directed graphs keep a second, transposed CSR so
+ * that bottom-up steps can pull along in-edges.
+ *
+ * VertexT is the vertex id type, EdgeT the type of the CSR offsets. EdgeT has
+ * to hold the number of directed edges, which overflows 32 bits on large
+ * inputs while the vertex ids still fit.
  */
-class LocalGraph : public BaseGraph {
+template <typename VertexT, typename EdgeT>
+class LocalGraph {
+  static_assert(std::is_signed_v<VertexT>, "NOT_VISITED is stored as -1");
+
 public:
-  using graph_type = std::vector<std::vector<int>>;
-  LocalGraph()     = default;
-  LocalGraph(int n) : m_graph(n), num_nodes(n) {}
-  ~LocalGraph() override = default;
+  using vertex_type = VertexT;
+  using edge_type   = EdgeT;
+  using edge_list   = std::vector<std::pair<VertexT, VertexT>>;
+  LocalGraph()      = default;
+  LocalGraph(VertexT n, bool directed = false)
+      : directed(directed), num_nodes(n) {}
+  LocalGraph(const LocalGraph &)            = delete;
+  LocalGraph &operator=(const LocalGraph &) = delete;
+  LocalGraph(LocalGraph &&)                 = default;
+  LocalGraph &operator=(LocalGraph &&)      = default;
+  ~LocalGraph()                             = default;
 
   void post_processing() {
-    for (auto &vertices : m_graph) {
-      m_serial_graph_start.push_back(m_serial_graph.size());
-      m_serial_graph_size.push_back(vertices.size());
-      for (const auto &v : vertices) m_serial_graph.push_back(v);
-      vertices.clear();
-      vertices.shrink_to_fit();  // dealloc memory
+    build_from_edges(num_nodes, m_edges);
+    m_edges.clear();
+    m_edges.shrink_to_fit();  // dealloc memory
+  }
+
+  /**
+   * @brief Build the CSR in two passes over an edge source, without staging
+   * per-vertex vectors: degree histogram, prefix sum, then scatter. Undirected
+   * graphs get a symmetric CSR, directed ones an out-edge CSR plus its
+   * transpose holding the in-edges.
+   *
+   * visit(c, f) calls f(u, v) for every edge of chunk c and has to produce the
+   * same edges on every pass. Self loops are dropped as in add_edge.
+   */
+  template <typename Visit>
+  void build(std::size_t n, int num_chunks, Visit &&visit) {
+    num_nodes = n;
+    if (directed) {
+      num_edges = build_csr(n, num_chunks, visit, false, m_serial_graph_start,
+                            m_serial_graph);
+      build_csr(
+          n, num_chunks,
+          [&visit](int c, auto &&f) {
+            visit(c, [&f](VertexT u, VertexT v) { f(v, u); });
+          },
+          false, m_in_serial_graph_start, m_in_serial_graph);
+    } else {
+      num_edges = build_csr(n, num_chunks, visit, true, m_serial_graph_start,
+                            m_serial_graph);
+    }
+
+    bind_views();
+  }
+
+  /**
+   * @brief One CSR out of an edge source, u -> v only or both directions.
+   * Returns the number of stored edges.
+   */
+  template <typename Visit>
+  static std::size_t build_csr(std::size_t n, int num_chunks, Visit &&visit,
+                               bool symmetric, std::vector<EdgeT> &offsets,
+                               std::vector<VertexT> &adj) {
+    std::vector<EdgeT> degree(n + 1, 0);
+
+    // Pass 1: degree histogram
+    std::size_t num_edges_ = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : num_edges_)
+    for (int c = 0; c < num_chunks; ++c) {
+      std::size_t chunk_edges = 0;
+      visit(c, [&](VertexT u, VertexT v) {
+        if (u == v) return;
+        __sync_fetch_and_add(&degree[u], 1);
+        ++chunk_edges;
+        if (symmetric) {
+          __sync_fetch_and_add(&degree[v], 1);
+          ++chunk_edges;
+        }
+      });
+      num_edges_ += chunk_edges;
+    }
+
+    offsets.resize(n + 1);
+    std::exclusive_scan(std::execution::par, degree.begin(), degree.end(),
+                        offsets.begin(), EdgeT(0));
+
+    // Pass 2: scatter through per-vertex cursors
+    std::copy(offsets.begin(), offsets.end() - 1, degree.begin());
+    adj.resize(num_edges_);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < num_chunks; ++c) {
+      visit(c, [&](VertexT u, VertexT v) {
+        if (u == v) return;
+        adj[__sync_fetch_and_add(&degree[u], 1)] = v;
+        if (symmetric) adj[__sync_fetch_and_add(&degree[v], 1)] = u;
+      });
+    }
+
+    return num_edges_;
+  }
+
+  /**
+   * @brief Build the CSR from an edge array, split into fixed index ranges so
+   * that both passes see the same edges per chunk
+   */
+  void build_from_edges(std::size_t n, const edge_list &edges) {
+    const int num_chunks = omp_get_max_threads() * 8;
+    build(n, num_chunks, [&edges, num_chunks](int c, auto &&f) {
+      const std::size_t first = edges.size() * c / num_chunks;
+      const std::size_t last  = edges.size() * (c + 1) / num_chunks;
+      for (std::size_t i = first; i < last; ++i)
+        f(edges[i].first, edges[i].second);
+    });
+  }
+
+  /**
+   * @brief Sort every adjacency list and drop repeated neighbors, e.g. the
+   * second copy of each edge in an already symmetric input. Returns the number
+   * of removed directed edges.
+   */
+  std::size_t deduplicate() {
+    std::size_t removed = deduplicate_csr(num_nodes, m_offsets, m_adj,
+                                          m_serial_graph_start, m_serial_graph);
+    if (directed)
+      deduplicate_csr(num_nodes, m_in_offsets, m_in_adj,
+                      m_in_serial_graph_start, m_in_serial_graph);
+
+    m_mapping.reset();  // every view points to the owned vectors now
+    num_edges -= removed;
+    bind_views();
+    return removed;
+  }
+
+  /**
+   * @brief Deduplicate the CSR behind the given views into offsets and adj,
+   * which may be the vectors the views point to
+   */
+  static std::size_t deduplicate_csr(std::size_t n, const EdgeT *offsets_view,
+                                     const VertexT *adj_view,
+                                     std::vector<EdgeT> &offsets,
+                                     std::vector<VertexT> &adj) {
+    std::vector<VertexT> sorted(adj_view, adj_view + offsets_view[n]);
+    std::vector<EdgeT>   degree(n + 1, 0);
+
+    // sort and unique each segment in place
+#pragma omp parallel for schedule(dynamic, 64)
+    for (std::size_t u = 0; u < n; ++u) {
+      VertexT *first = sorted.data() + offsets_view[u];
+      VertexT *last  = sorted.data() + offsets_view[u + 1];
+      std::sort(first, last);
+      degree[u] = std::unique(first, last) - first;
+    }
+
+    std::vector<EdgeT> new_offsets(n + 1);
+    std::exclusive_scan(std::execution::par, degree.begin(), degree.end(),
+                        new_offsets.begin(), EdgeT(0));
+
+    // compact the unique prefixes of the segments
+    std::vector<VertexT> compact(new_offsets[n]);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (std::size_t u = 0; u < n; ++u) {
+      std::copy_n(sorted.data() + offsets_view[u], degree[u],
+                  compact.data() + new_offsets[u]);
+    }
+
+    const std::size_t removed = sorted.size() - compact.size();
+    offsets                   = std::move(new_offsets);
+    adj                       = std::move(compact);
+    return removed;
+  }
+
+  /**
+   * @brief Relabel every vertex u as new_id[u], neighbor lists are sorted in
+   * the new labels
+   */
+  void permute(const std::vector<VertexT> &new_id) {
+    std::vector<VertexT> old_id(num_nodes);
+#pragma omp parallel for
+    for (std::size_t u = 0; u < num_nodes; ++u) old_id[new_id[u]] = u;
+
+    permute_csr(num_nodes, m_offsets, m_adj, new_id, old_id,
+                m_serial_graph_start, m_serial_graph);
+    if (directed)
+      permute_csr(num_nodes, m_in_offsets, m_in_adj, new_id, old_id,
+                  m_in_serial_graph_start, m_in_serial_graph);
+
+    m_mapping.reset();  // every view points to the owned vectors now
+    bind_views();
+  }
+
+  static void permute_csr(std::size_t n, const EdgeT *offsets_view,
+                          const VertexT *adj_view,
+                          const std::vector<VertexT> &new_id,
+                          const std::vector<VertexT> &old_id,
+                          std::vector<EdgeT> &offsets,
+                          std::vector<VertexT> &adj) {
+    std::vector<EdgeT> degree(n + 1, 0);
+#pragma omp parallel for
+    for (std::size_t v = 0; v < n; ++v)
+      degree[v] = offsets_view[old_id[v] + 1] - offsets_view[old_id[v]];
+
+    std::vector<EdgeT> new_offsets(n + 1);
+    std::exclusive_scan(std::execution::par, degree.begin(), degree.end(),
+                        new_offsets.begin(), EdgeT(0));
+
+    std::vector<VertexT> new_adj(new_offsets[n]);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (std::size_t v = 0; v < n; ++v) {
+      const VertexT *first = adj_view + offsets_view[old_id[v]];
+      VertexT       *out   = new_adj.data() + new_offsets[v];
+      for (EdgeT i = 0; i < degree[v]; ++i) out[i] = new_id[first[i]];
+      std::sort(out, out + degree[v]);
     }
 
-    m_graph.clear();
-    m_graph.shrink_to_fit();
+    offsets = std::move(new_offsets);
+    adj     = std::move(new_adj);
+  }
+
+  /**
+   * @brief Point the CSR views to the owned vectors
+   */
+  void bind_views() {
+    m_adj     = m_serial_graph.data();
+    m_offsets = m_serial_graph_start.data();
+    if (directed) {
+      m_in_adj     = m_in_serial_graph.data();
+      m_in_offsets = m_in_serial_graph_start.data();
+    } else {
+      m_in_adj     = m_adj;
+      m_in_offsets = m_offsets;
+    }
   }
 
-  FORCEINLINE void add_edge(int u, int v) override {
+  FORCEINLINE void add_edge(VertexT u, VertexT v) {
     if (u == v) return;
-    num_edges += 2;
-    m_graph[u].push_back(v);
-    m_graph[v].push_back(u);
+    num_edges += directed ? 1 : 2;
+    m_edges.emplace_back(u, v);
+  }
+
+  FORCEINLINE VertexT get_num_nodes() const { return num_nodes; }
+
+  FORCEINLINE VertexT get_edge(VertexT u, std::size_t i) const {
+    return m_adj[m_offsets[u] + i];
+  }
+
+  FORCEINLINE std::size_t get_num_edges(VertexT u) const {
+    return m_offsets[u + 1] - m_offsets[u];
+  }
+
+  FORCEINLINE const VertexT *get_neighbors(VertexT u) const {
+    return m_adj + m_offsets[u];
+  }
+
+  /**
+   * @brief In-edges of v, the same as the out-edges on undirected graphs
+   */
+  FORCEINLINE std::size_t get_num_in_edges(VertexT v) const {
+    return m_in_offsets[v + 1] - m_in_offsets[v];
   }
 
-  FORCEINLINE int get_num_nodes() const override { return num_nodes; }
+  FORCEINLINE const VertexT *get_in_neighbors(VertexT v) const {
+    return m_in_adj + m_in_offsets[v];
+  }
 
-  FORCEINLINE int get_edge(int u, std::size_t i) const override {
-    return m_serial_graph[m_serial_graph_start[u] + i];
+  /**
+   * @brief Neighbor ranges the kernels iterate over
+   */
+  FORCEINLINE std::span<const VertexT> neighbors(VertexT u) const {
+    return {get_neighbors(u), get_num_edges(u)};
   }
 
-  FORCEINLINE std::size_t get_num_edges(int u) const override {
-    return m_serial_graph_size[u];
+  FORCEINLINE std::span<const VertexT> in_neighbors(VertexT v) const {
+    return {get_in_neighbors(v), get_num_in_edges(v)};
   }
 
-  graph_type       m_graph;
-  std::vector<int> m_serial_graph;
-  std::vector<int> m_serial_graph_start;
-  std::vector<int> m_serial_graph_size;
+  edge_list            m_edges;  // staged by add_edge until post_processing
+  std::vector<VertexT> m_serial_graph;
+  std::vector<EdgeT>   m_serial_graph_start;  // num_nodes + 1 entries
+  std::vector<VertexT> m_in_serial_graph;     // transpose, directed only
+  std::vector<EdgeT>   m_in_serial_graph_start;
+
+  // CSR views used by the kernels
+  const VertexT              *m_adj{nullptr};
+  const EdgeT                *m_offsets{nullptr};
+  const VertexT              *m_in_adj{nullptr};
+  const EdgeT                *m_in_offsets{nullptr};
+  std::shared_ptr<MappedFile> m_mapping;
 
+  bool        directed{false};
   std::size_t num_nodes{0};
   std::size_t num_edges{0};
 };
 
-class BoostGraph : public BaseGraph {
+/**
+ * @brief Adjacency list graph backed by Boost, out- and in-edges are both
+ * reachable through bidirectionalS
+ */
+class BoostGraph {
 public:
+  using vertex_type = int;
   using graph_type =
       boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS>;
 
   BoostGraph() = default;
   BoostGraph(int n) : m_graph(n) {}
-  ~BoostGraph() override = default;
-  FORCEINLINE void add_edge(int u, int v) override {
+  FORCEINLINE void add_edge(int u, int v) {
     boost::add_edge(u, v, m_graph);
+    ++num_edges;
+  }
+
+  FORCEINLINE int get_num_nodes() const { return boost::num_vertices(m_graph); }
+
+  FORCEINLINE std::size_t get_num_edges(int u) const {
+    return boost::out_degree(u, m_graph);
+  }
+
+  FORCEINLINE std::size_t get_num_in_edges(int v) const {
+    return boost::in_degree(v, m_graph);
+  }
+
+  FORCEINLINE auto neighbors(int u) const {
+    const auto [first, last] = boost::adjacent_vertices(u, m_graph);
+    return std::ranges::subrange(first, last);
+  }
+
+  FORCEINLINE auto in_neighbors(int v) const {
+    const auto [first, last] = boost::inv_adjacent_vertices(v, m_graph);
+    return std::ranges::subrange(first, last);
   }
 
-  FORCEINLINE int get_num_nodes() const override { return 0; }
+  graph_type  m_graph;
+  std::size_t num_edges{0};
+};
+
+// Compact layout for graphs below 2^32 directed edges, and the layout for the
+// larger ones
+using SmallGraph = LocalGraph<int32_t, uint32_t>;
+using LargeGraph = LocalGraph<int32_t, uint64_t>;
+static_assert(Graph<SmallGraph> && Graph<LargeGraph> && Graph<BoostGraph>);
+
+/**
+ * @brief G with every edge reversed, without copying it. Kernels run on the
+ * view walk the in-edges of G, e.g. to search backwards from a target.
+ */
+template <Graph GraphT>
+struct TransposeView {
+  using vertex_type = typename GraphT::vertex_type;
+
+  TransposeView(const GraphT &G) : G(G), num_edges(G.num_edges) {}
 
-  FORCEINLINE int get_edge(int u, std::size_t i) const override {
-    assert(false);
+  FORCEINLINE vertex_type get_num_nodes() const { return G.get_num_nodes(); }
+
+  FORCEINLINE std::size_t get_num_edges(vertex_type u) const {
+    return G.get_num_in_edges(u);
+  }
+
+  FORCEINLINE std::size_t get_num_in_edges(vertex_type v) const {
+    return G.get_num_edges(v);
   }
 
-  FORCEINLINE std::size_t get_num_edges(int u) const override { assert(false); }
+  FORCEINLINE auto neighbors(vertex_type u) const { return G.in_neighbors(u); }
+
+  FORCEINLINE auto in_neighbors(vertex_type v) const { return G.neighbors(v); }
+
+  FORCEINLINE auto neighbors_from(vertex_type u, std::size_t j) const
+    requires SeekableNeighbors<GraphT>
+  {
+    return G.in_neighbors_from(u, j);
+  }
 
-  graph_type m_graph;
+  const GraphT &G;
+  std::size_t   num_edges;
 };
 
-using Graph = LocalGraph;
+static_assert(Graph<TransposeView<SmallGraph>>);
+
+/**
+ * @brief Build the graph from the edge lines of [begin, end), the text is split
+ * into one chunk per thread and scanned once per CSR pass, so no edge list is
+ * ever materialized.
+ */
+template <typename GraphT>
+inline void GraphFromEdgeLines(const char *begin, const char *end,
+                               char comment, std::size_t n, bool directed,
+                               GraphT &G) {
+  const auto bounds = SplitLines(begin, end, omp_get_max_threads());
+  G                 = GraphT();
+  G.directed        = directed;
+  G.build(n, bounds.size() - 1, [&bounds, comment](int c, auto &&f) {
+    ForEachEdgeLine(bounds[c], bounds[c + 1], comment, f);
+  });
+}
+
+/**
+ * @brief Largest vertex id of the edge lines in [begin, end), one chunk per
+ * thread
+ */
+inline uint64_t MaxVertexId(const char *begin, const char *end, char comment) {
+  const auto bounds = SplitLines(begin, end, omp_get_max_threads());
+
+  uint64_t max_id = 0;
+#pragma omp parallel for schedule(static, 1) reduction(max : max_id)
+  for (int i = 0; i < static_cast<int>(bounds.size()) - 1; ++i) {
+    uint64_t chunk_max = 0;
+    ForEachEdgeLine(bounds[i], bounds[i + 1], comment,
+                    [&chunk_max](uint64_t u, uint64_t v) {
+                      chunk_max = std::max(chunk_max, std::max(u, v));
+                    });
+    max_id = std::max(max_id, chunk_max);
+  }
+
+  return max_id;
+}
+
+/**
+ * @brief Throw unless the ids up to max_id fit the vertex type of GraphT and
+ * stay within bound
+ */
+template <typename GraphT>
+inline void CheckVertexIds(const std::string &filename, uint64_t max_id,
+                           uint64_t bound) {
+  using vertex_type = typename GraphT::vertex_type;
+  if (max_id > bound)
+    throw GraphFileError(
+        fmt::format("{}: vertex id {} exceeds {}", filename, max_id, bound));
+  if (max_id >= uint64_t(std::numeric_limits<vertex_type>::max()))
+    throw GraphFileError(fmt::format(
+        "{}: vertex id {} does not fit the vertex id type", filename, max_id));
+}
 
-inline void GraphFromMM(const std::string &filename, Graph &G) {
+/**
+ * @brief Parallel MatrixMarket loader. The header is parsed once, the body is
+ * then handed to GraphFromEdgeLines. Matrices declared symmetric store one
+ * triangle only and are always loaded as undirected.
+ */
+template <typename GraphT>
+inline void GraphFromMM(const std::string &filename, GraphT &G,
+                        bool directed = false) {
   Info("reading {}", filename);
-  bool header    = false;
-  bool file_info = false;
-  int  M, N, L;
-
-  FILE       *ifile = fopen(filename.data(), "r");
-  char       *line  = new char[4096];
-  int         nread = 0;
-  std::size_t n;
-
-  while ((nread = getline(&line, &n, ifile)) != -1) {
-    if (n == 1 || line[0] == '%') continue;
-    bool header_ = header;
-    header       = true;  // trans to header finished
-    if (!header_ && header) {
-      file_info = true;
-      std::sscanf(line, "%d %d %d", &M, &N, &L);
-      Info("{} {} {}", M, N, L);
-      assert(M == N);
-      G = Graph(M + 1);
+  MappedFile file(filename);
+  file.advise(MADV_SEQUENTIAL);
+
+  const char *p   = file.data();
+  const char *end = file.data() + file.size();
+
+  // skip the banner and comments, then read the size line
+  uint64_t M = 0, N = 0, L = 0;
+  while (p != end) {
+    const char *line_end =
+        static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (line_end == nullptr) line_end = end;
+    const char *q = p;
+    p             = line_end == end ? end : line_end + 1;
+    while (q != line_end && IsBlank(*q)) ++q;
+    if (q == line_end) continue;
+    if (*q == '%') {
+      if (std::string_view(q, line_end).starts_with("%%MatrixMarket") &&
+          std::string_view(q, line_end).find("symmetric") !=
+              std::string_view::npos)
+        directed = false;
       continue;
-    } else {
-      // read common file content
-      assert(header);
-      assert(file_info);
-      int row, column, weight;
-      std::sscanf(line, "%d %d %d", &row, &column, &weight);
-      assert(weight == 1);
-      G.add_edge(row, column);
     }
+
+    if (!(q = ParseUint(q, line_end, M)) || !(q = ParseUint(q, line_end, N)) ||
+        !ParseUint(q, line_end, L))
+      throw GraphFileError(fmt::format("{}: malformed size line", filename));
+
+    break;
   }
 
-  Info("{}", G.m_graph.size());
-  G.post_processing();
-  fclose(ifile);
-  delete[] line;
+  Info("{} {} {}", M, N, L);
+  if (M != N)
+    throw GraphFileError(fmt::format("{}: matrix is not square", filename));
+  CheckVertexIds<GraphT>(filename, MaxVertexId(p, end, '%'), M);
+
+  GraphFromEdgeLines(p, end, '%', M + 1, directed, G);
+  Info("{}", G.get_num_nodes());
 }
 
-inline void GraphFromTxt(const std::string &filename, Graph &G,
-                         std::vector<std::pair<int, int>> &edges) {
+/**
+ * @brief Parallel SNAP edge list loader. A first scan finds the largest vertex
+ * id, the CSR is then built directly from the mapped text.
+ */
+template <typename GraphT>
+inline void GraphFromTxt(const std::string &filename, GraphT &G,
+                         bool directed = false) {
   Info("reading {}", filename);
-  FILE       *ifile = fopen(filename.data(), "r");
-  char       *line  = new char[4096];
-  int         nread = 0;
-  std::size_t n;
+  MappedFile file(filename);
+  file.advise(MADV_SEQUENTIAL);
 
-  int num_vertices = 0;
-  while ((nread = getline(&line, &n, ifile)) != -1) {
-    if (n == 1 || line[0] == '#') continue;
-    int u, v;
-    std::sscanf(line, "%d %d", &u, &v);
-    edges.emplace_back(std::make_pair(u, v));
-    num_vertices = std::max(num_vertices, std::max(u, v));
-  }
+  const char    *begin  = file.data();
+  const char    *end    = file.data() + file.size();
+  const uint64_t max_id = MaxVertexId(begin, end, '#');
+  CheckVertexIds<GraphT>(filename, max_id,
+                         std::numeric_limits<uint64_t>::max());
 
-  fclose(ifile);
   Info("read finished");
+  GraphFromEdgeLines(begin, end, '#', max_id + 1, directed, G);
+}
+
+/**
+ * @brief On-disk binary CSR layout, version 1
+ *
+ * | header (64 bytes) | offsets[num_nodes + 1] | adjacency[num_edges] |
+ *
+ * Directed graphs (kDirected in flags) append the transposed CSR in the same
+ * form, in_offsets then in_adjacency. Every section starts at the next 64-byte
+ * aligned position, so that the loader can use the mapped arrays in place.
+ */
+struct BinGraphHeader {
+  static constexpr char     kMagic[8] = {'P', 'B', 'F', 'S', 'C', 'S', 'R', 0};
+  static constexpr uint32_t kVersion  = 1;
+  static constexpr uint32_t kDirected = 1u << 0;
+
+  char     magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t num_nodes;
+  uint64_t num_edges;
+  uint32_t vertex_bytes;
+  uint32_t offset_bytes;
+  uint64_t offsets_pos;
+  uint64_t adj_pos;
+  uint64_t reserved;
+
+  uint64_t offsets_size() const { return (num_nodes + 1) * offset_bytes; }
+  uint64_t adj_size() const { return num_edges * vertex_bytes; }
+  uint64_t in_offsets_pos() const { return align(adj_pos + adj_size()); }
+  uint64_t in_adj_pos() const {
+    return align(in_offsets_pos() + offsets_size());
+  }
+
+  uint64_t file_size() const {
+    return flags & kDirected ? in_adj_pos() + adj_size()
+                             : adj_pos + adj_size();
+  }
+
+  /**
+   * @brief Whether the sections sit where GraphToBin puts them and end within
+   * file_bytes. The counts are bounded by file_bytes first, so none of the
+   * section sizes can wrap around.
+   */
+  bool fits(uint64_t file_bytes) const {
+    if (vertex_bytes == 0 || offset_bytes == 0 ||
+        num_nodes >= file_bytes / offset_bytes ||
+        num_edges > file_bytes / vertex_bytes)
+      return false;
+    return offsets_pos == align(sizeof(BinGraphHeader)) &&
+           adj_pos == align(offsets_pos + offsets_size()) &&
+           file_size() <= file_bytes;
+  }
+
+  static uint64_t align(uint64_t pos) { return (pos + 63) & ~uint64_t(63); }
+};
+static_assert(sizeof(BinGraphHeader) == 64);
 
-  G = Graph(num_vertices + 1);
+template <typename GraphT>
+inline void GraphToBin(const std::string &filename, const GraphT &G) {
+  using vertex_type = typename GraphT::vertex_type;
+  using edge_type   = typename GraphT::edge_type;
 
-  Info("adding edges");
-  for (const auto &edge : edges) G.add_edge(edge.first, edge.second);
+  Info("writing {}", filename);
+  BinGraphHeader header{};
+  std::memcpy(header.magic, BinGraphHeader::kMagic, sizeof(header.magic));
+  header.version      = BinGraphHeader::kVersion;
+  header.flags        = G.directed ? BinGraphHeader::kDirected : 0;
+  header.num_nodes    = G.get_num_nodes();
+  header.num_edges    = G.num_edges;
+  header.vertex_bytes = sizeof(vertex_type);
+  header.offset_bytes = sizeof(edge_type);
+  header.offsets_pos  = BinGraphHeader::align(sizeof(BinGraphHeader));
+  header.adj_pos =
+      BinGraphHeader::align(header.offsets_pos + header.offsets_size());
 
-  edges.clear();
-  edges.shrink_to_fit();
+  // G may be mapped from filename itself, it is replaced only once complete
+  ReplacingFile file(filename);
+  auto write_section = [&file](uint64_t pos, const void *data, uint64_t size) {
+    file.pad_to(pos);
+    file.write(data, size);
+  };
+
+  file.write(&header, sizeof(header));
+  write_section(header.offsets_pos, G.m_offsets, header.offsets_size());
+  write_section(header.adj_pos, G.m_adj, header.adj_size());
+  if (G.directed) {
+    write_section(header.in_offsets_pos(), G.m_in_offsets,
+                  header.offsets_size());
+    write_section(header.in_adj_pos(), G.m_in_adj, header.adj_size());
+  }
+
+  file.commit();
+}
+
+/**
+ * @brief Read and check the header of a mapped binary CSR file
+ */
+inline BinGraphHeader ReadBinHeader(const std::string &filename,
+                                    const MappedFile &file) {
+  BinGraphHeader header;
+  if (file.size() < sizeof(header))
+    throw GraphFileError(fmt::format("{} is not a binary graph", filename));
+
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, BinGraphHeader::kMagic, sizeof(header.magic)) !=
+          0 ||
+      header.version != BinGraphHeader::kVersion)
+    throw GraphFileError(
+        fmt::format("{}: bad magic or unsupported version", filename));
+
+  return header;
+}
+
+/**
+ * @brief Map a binary CSR file, the graph reads the mapped arrays in place
+ */
+template <typename GraphT>
+inline void GraphFromBin(const std::string &filename, GraphT &G) {
+  using vertex_type = typename GraphT::vertex_type;
+  using edge_type   = typename GraphT::edge_type;
+
+  Info("mapping {}", filename);
+  auto       mapping = std::make_shared<MappedFile>(filename);
+  const auto header  = ReadBinHeader(filename, *mapping);
+  if (header.vertex_bytes != sizeof(vertex_type) ||
+      header.offset_bytes != sizeof(edge_type) ||
+      header.num_nodes > uint64_t(std::numeric_limits<vertex_type>::max()) ||
+      header.num_edges > uint64_t(std::numeric_limits<edge_type>::max()))
+    throw GraphFileError(
+        fmt::format("{}: layout does not match the graph type", filename));
+  if (!header.fits(mapping->size()))
+    throw GraphFileError(fmt::format("{}: truncated or corrupt", filename));
+
+  auto section = [&mapping](uint64_t pos) { return mapping->data() + pos; };
+
+  G           = GraphT();
+  G.directed  = header.flags & BinGraphHeader::kDirected;
+  G.num_nodes = header.num_nodes;
+  G.num_edges = header.num_edges;
+  G.m_offsets = reinterpret_cast<const edge_type *>(section(header.offsets_pos));
+  G.m_adj     = reinterpret_cast<const vertex_type *>(section(header.adj_pos));
+  if (G.directed) {
+    G.m_in_offsets =
+        reinterpret_cast<const edge_type *>(section(header.in_offsets_pos()));
+    G.m_in_adj =
+        reinterpret_cast<const vertex_type *>(section(header.in_adj_pos()));
+  } else {
+    G.m_in_offsets = G.m_offsets;
+    G.m_in_adj     = G.m_adj;
+  }
+
+  G.m_mapping = std::move(mapping);
+}
+
+/**
+ * @brief Load a graph by the suffix of filename, .mm, .txt or .bin
+ */
+template <typename GraphT>
+inline void GraphFromFile(const std::string &filename, GraphT &G,
+                          bool directed) {
+  if (filename.ends_with(".mm")) {
+    GraphFromMM(filename, G, directed);
+  } else if (filename.ends_with(".txt")) {
+    GraphFromTxt(filename, G, directed);
+  } else if (filename.ends_with(".bin")) {
+    GraphFromBin(filename, G);
+  } else {
+    throw GraphFileError(fmt::format("{}: suffix not matched", filename));
+  }
+}
+
+/**
+ * @brief Whether the graph in filename may need 64-bit CSR offsets. Binary
+ * files record their offset width, text files are bounded by their size since
+ * every edge line takes at least 4 bytes and yields at most 2 directed edges.
+ */
+inline bool GraphNeedsLargeOffsets(const std::string &filename) {
+  MappedFile file(filename);
+  if (filename.ends_with(".bin"))
+    return ReadBinHeader(filename, file).offset_bytes > sizeof(uint32_t);
+  return file.size() / 2 > std::numeric_limits<uint32_t>::max();
+}
+
+/**
+ * @brief Dense to original vertex id mapping written by bfs-convert. The file
+ * is a raw uint64_t array sorted ascending, original ids are found by binary
+ * search.
+ */
+class IdMap {
+public:
+  IdMap() = default;
+  explicit IdMap(const std::string &filename)
+      : m_mapping(std::make_shared<MappedFile>(filename)) {
+    m_ids  = reinterpret_cast<const uint64_t *>(m_mapping->data());
+    m_size = m_mapping->size() / sizeof(uint64_t);
+  }
+
+  FORCEINLINE bool        empty() const { return m_size == 0; }
+  FORCEINLINE std::size_t size() const { return m_size; }
+
+  FORCEINLINE uint64_t to_original(std::size_t v) const {
+    return empty() ? v : m_ids[v];
+  }
+
+  /**
+   * @brief Dense id of an original id, -1 if it does not appear in the graph
+   */
+  int64_t to_dense(uint64_t id) const {
+    if (empty()) return id;
+    const uint64_t *it = std::lower_bound(m_ids, m_ids + m_size, id);
+    return it != m_ids + m_size && *it == id ? it - m_ids : -1;
+  }
+
+private:
+  std::shared_ptr<MappedFile> m_mapping;
+  const uint64_t             *m_ids{nullptr};
+  std::size_t                 m_size{0};
+};
 
-  Info("post processing");
-  G.post_processing();
+inline void WriteIdMap(const std::string &filename,
+                       const std::vector<uint64_t> &ids) {
+  Info("writing {}", filename);
+  ReplacingFile file(filename);
+  file.write(ids.data(), ids.size() * sizeof(uint64_t));
+  file.commit();
 }
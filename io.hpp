@@ -0,0 +1,194 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+/**
+ * @brief Unreadable or malformed graph input, or an output file that cannot
+ * be written. The tools report it and exit, libbfs turns it into a status
+ * code.
+ */
+struct GraphFileError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Read-only memory mapping of a whole file. The mapping is shared, so
+ * several processes opening the same file share the page cache.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &filename) {
+    int fd = open(filename.data(), O_RDONLY);
+    if (fd < 0) throw GraphFileError(fmt::format("cannot open {}", filename));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw GraphFileError(fmt::format("cannot stat {}", filename));
+    }
+
+    m_size = st.st_size;
+    if (m_size != 0) {
+      void *ptr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr == MAP_FAILED) {
+        close(fd);
+        throw GraphFileError(fmt::format("cannot mmap {}", filename));
+      }
+      m_data = static_cast<const char *>(ptr);
+    }
+
+    close(fd);  // the mapping keeps its own reference
+  }
+
+  MappedFile(const MappedFile &)            = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() {
+    if (m_data != nullptr) munmap(const_cast<char *>(m_data), m_size);
+  }
+
+  /**
+   * @brief Hint the kernel about the access pattern of the mapping
+   */
+  void advise(int advice) const {
+    if (m_data != nullptr) madvise(const_cast<char *>(m_data), m_size, advice);
+  }
+
+  FORCEINLINE const char *data() const { return m_data; }
+  FORCEINLINE std::size_t size() const { return m_size; }
+
+private:
+  const char *m_data{nullptr};
+  std::size_t m_size{0};
+};
+
+/**
+ * @brief Output file written as <name>.tmp and renamed over <name> by commit.
+ * Processes that map the old file keep reading it, and a file is never
+ * truncated under its own readers. Without commit the temporary is removed.
+ */
+class ReplacingFile {
+public:
+  explicit ReplacingFile(const std::string &filename)
+      : m_filename(filename), m_tmp_filename(filename + ".tmp") {
+    m_file = std::fopen(m_tmp_filename.data(), "wb");
+    if (m_file == nullptr)
+      throw GraphFileError(fmt::format("cannot open {}", m_tmp_filename));
+  }
+
+  ReplacingFile(const ReplacingFile &)            = delete;
+  ReplacingFile &operator=(const ReplacingFile &) = delete;
+  ~ReplacingFile() {
+    if (m_file == nullptr) return;
+    std::fclose(m_file);
+    unlink(m_tmp_filename.data());
+  }
+
+  /**
+   * @brief Append size bytes, empty writes are skipped
+   */
+  void write(const void *data, std::size_t size) {
+    if (size == 0) return;
+    if (std::fwrite(data, 1, size, m_file) != size)
+      throw GraphFileError(fmt::format("cannot write {}", m_tmp_filename));
+    m_size += size;
+  }
+
+  /**
+   * @brief Zero bytes up to pos
+   */
+  void pad_to(std::size_t pos) {
+    static constexpr char kZeros[64] = {};
+    while (m_size < pos) write(kZeros, std::min(pos - m_size, sizeof(kZeros)));
+  }
+
+  void commit() {
+    FILE *file = m_file;
+    m_file     = nullptr;
+    if (std::fclose(file) != 0 ||
+        std::rename(m_tmp_filename.data(), m_filename.data()) != 0) {
+      unlink(m_tmp_filename.data());
+      throw GraphFileError(fmt::format("cannot write {}", m_filename));
+    }
+  }
+
+private:
+  std::string m_filename;
+  std::string m_tmp_filename;
+  FILE       *m_file{nullptr};
+  std::size_t m_size{0};
+};
+
+/**
+ * @brief Split [begin, end) into num_chunks pieces that start at line
+ * boundaries. Returns num_chunks + 1 boundaries, some chunks may be empty.
+ */
+inline std::vector<const char *> SplitLines(const char *begin, const char *end,
+                                            int num_chunks) {
+  std::vector<const char *> bounds(num_chunks + 1, end);
+  bounds[0]         = begin;
+  const auto length = end - begin;
+  for (int i = 1; i < num_chunks; ++i) {
+    const char *p = std::max(begin + length * i / num_chunks, bounds[i - 1]);
+    // move to the first character after a newline
+    while (p != end && p != begin && p[-1] != '\n') ++p;
+    bounds[i] = p;
+  }
+
+  return bounds;
+}
+
+FORCEINLINE bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * @brief Hand-written unsigned integer scanner, skips leading blanks. Returns
+ * nullptr when no digit is found before the end of the line.
+ */
+FORCEINLINE const char *ParseUint(const char *p, const char *end,
+                                  uint64_t &value) {
+  while (p != end && IsBlank(*p)) ++p;
+  if (p == end || *p < '0' || *p > '9') return nullptr;
+  value = 0;
+  while (p != end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+  return p;
+}
+
+/**
+ * @brief Call f(u, v) for the first two integers of each line in [begin, end),
+ * lines starting with the comment character or without two integers are
+ * skipped.
+ */
+template <typename F>
+inline void ForEachEdgeLine(const char *begin, const char *end, char comment,
+                            F &&f) {
+  const char *p = begin;
+  while (p != end) {
+    const char *line_end =
+        static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (line_end == nullptr) line_end = end;
+
+    uint64_t    u, v;
+    const char *q = p;
+    while (q != line_end && IsBlank(*q)) ++q;
+    if (q != line_end && *q != comment && (q = ParseUint(q, line_end, u)) &&
+        (q = ParseUint(q, line_end, v)))
+      f(u, v);
+
+    p = line_end == end ? end : line_end + 1;
+  }
+}
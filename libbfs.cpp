@@ -0,0 +1,220 @@
+#include "libbfs.hpp"
+
+#include <omp.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "bfs.hpp"
+#include "common.h"
+#include "graph.hpp"
+#include "sparse.hpp"
+
+/**
+ * @brief BfsGraph over one instantiation of the kernels. The solution is
+ * epoch-stamped, so a run costs the reset of a fresh one only the first time.
+ */
+template <typename GraphT>
+class BfsGraphOf final : public BfsGraph {
+public:
+  explicit BfsGraphOf(GraphT G) : m_G(std::move(G)) { m_sol.stamped = true; }
+
+  std::size_t num_nodes() const override { return m_G.get_num_nodes(); }
+  std::size_t num_edges() const override { return m_G.num_edges; }
+
+  int run(int64_t source, const BfsOptions &options, int32_t *depths,
+          int32_t *parents) override {
+    using vertex_type = typename GraphT::vertex_type;
+
+    const std::size_t n = m_G.get_num_nodes();
+    if (source < 0 || std::size_t(source) >= n) return BFS_ERROR_ARGUMENT;
+    if (options.method < BFS_TOP_DOWN || options.method > BFS_PERSISTENT)
+      return BFS_ERROR_ARGUMENT;
+
+    // the thread count of the caller is restored afterwards, even on a throw
+    struct ThreadCount {
+      ~ThreadCount() { omp_set_num_threads(num_threads); }
+      int num_threads;
+    } caller{omp_get_max_threads()};
+    if (options.num_threads > 0) omp_set_num_threads(options.num_threads);
+
+    const auto s = vertex_type(source);
+    switch (options.method) {
+      case BFS_TOP_DOWN:
+        BfsTopDown(m_G, s, m_sol, m_ws);
+        break;
+      case BFS_BOTTOM_UP:
+        BfsBottomUp(m_G, s, m_sol, m_ws);
+        break;
+      case BFS_HYBRID:
+        BfsHybrid(m_G, s, m_sol, m_ws);
+        break;
+      case BFS_LOCAL:
+        BfsLocal(m_G, s, m_visits, m_sol, m_ws);
+        ScatterVisits(m_visits, n, s, m_sol);
+        break;
+      case BFS_PERSISTENT:
+        BfsTopDownPersistent(m_G, s, m_sol, m_ws);
+        break;
+    }
+
+#pragma omp parallel for
+    for (std::size_t v = 0; v < n; ++v) {
+      if (depths != nullptr) depths[v] = m_sol.depth(v);
+      if (parents != nullptr) parents[v] = m_sol.parent_of(v);
+    }
+
+    return BFS_OK;
+  }
+
+private:
+  GraphT              m_G;
+  SolutionOf<GraphT>  m_sol;
+  WorkspaceOf<GraphT> m_ws;
+  VisitsOf<GraphT>    m_visits;
+};
+
+int BfsGraphLoad(const std::string &filename, bool directed,
+                 std::unique_ptr<BfsGraph> &graph) {
+  // the loaders throw on what they cannot read or parse
+  try {
+    if (GraphNeedsLargeOffsets(filename)) {
+      LargeGraph G;
+      GraphFromFile(filename, G, directed);
+      graph = std::make_unique<BfsGraphOf<LargeGraph>>(std::move(G));
+    } else {
+      SmallGraph G;
+      GraphFromFile(filename, G, directed);
+      graph = std::make_unique<BfsGraphOf<SmallGraph>>(std::move(G));
+    }
+  } catch (const GraphFileError &) {
+    return BFS_ERROR_IO;
+  }
+
+  return BFS_OK;
+}
+
+template <typename GraphT>
+static std::unique_ptr<BfsGraph> BuildGraph(int64_t        num_nodes,
+                                            const int64_t *src,
+                                            const int64_t *dst,
+                                            std::size_t    num_edges,
+                                            bool           directed) {
+  const int num_chunks = omp_get_max_threads();
+  GraphT    G(num_nodes, directed);
+  G.build(num_nodes, num_chunks, [&](int c, auto &&f) {
+    const std::size_t first = num_edges * c / num_chunks;
+    const std::size_t last  = num_edges * (c + 1) / num_chunks;
+    for (std::size_t i = first; i < last; ++i) f(src[i], dst[i]);
+  });
+  return std::make_unique<BfsGraphOf<GraphT>>(std::move(G));
+}
+
+int BfsGraphFromEdges(int64_t num_nodes, const int64_t *src,
+                      const int64_t *dst, std::size_t num_edges, bool directed,
+                      std::unique_ptr<BfsGraph> &graph) {
+  using vertex_type = SmallGraph::vertex_type;
+  if (num_nodes < 0 || num_nodes > std::numeric_limits<vertex_type>::max())
+    return BFS_ERROR_ARGUMENT;
+  if (num_edges != 0 && (src == nullptr || dst == nullptr))
+    return BFS_ERROR_ARGUMENT;
+
+  bool valid = true;
+#pragma omp parallel for reduction(&& : valid)
+  for (std::size_t i = 0; i < num_edges; ++i)
+    valid = valid && src[i] >= 0 && src[i] < num_nodes && dst[i] >= 0 &&
+            dst[i] < num_nodes;
+  if (!valid) return BFS_ERROR_ARGUMENT;
+
+  // undirected graphs store both directions
+  if (2 * num_edges > std::numeric_limits<uint32_t>::max())
+    graph = BuildGraph<LargeGraph>(num_nodes, src, dst, num_edges, directed);
+  else
+    graph = BuildGraph<SmallGraph>(num_nodes, src, dst, num_edges, directed);
+  return BFS_OK;
+}
+
+/**
+ * @brief Status of f at the C boundary, no exception unwinds into the caller
+ */
+template <typename F>
+static int Guarded(F &&f) noexcept {
+  try {
+    return f();
+  } catch (...) {
+    return BFS_ERROR_INTERNAL;
+  }
+}
+
+/**
+ * @brief The C handle owns its C++ graph
+ */
+struct bfs_graph {
+  std::unique_ptr<BfsGraph> graph;
+};
+
+extern "C" {
+
+void bfs_options_init(bfs_options *options) {
+  options->size        = sizeof(bfs_options);
+  options->method      = BFS_HYBRID;
+  options->num_threads = 0;
+}
+
+int bfs_graph_load(const char *filename, int directed, bfs_graph **graph) {
+  if (filename == nullptr || graph == nullptr) return BFS_ERROR_ARGUMENT;
+
+  return Guarded([&] {
+    auto      handle = std::make_unique<bfs_graph>();
+    const int status = BfsGraphLoad(filename, directed != 0, handle->graph);
+    if (status != BFS_OK) return status;
+    *graph = handle.release();
+    return BFS_OK;
+  });
+}
+
+int bfs_graph_from_edges(int64_t num_nodes, const int64_t *src,
+                         const int64_t *dst, size_t num_edges, int directed,
+                         bfs_graph **graph) {
+  if (graph == nullptr) return BFS_ERROR_ARGUMENT;
+
+  return Guarded([&] {
+    auto      handle = std::make_unique<bfs_graph>();
+    const int status = BfsGraphFromEdges(num_nodes, src, dst, num_edges,
+                                         directed != 0, handle->graph);
+    if (status != BFS_OK) return status;
+    *graph = handle.release();
+    return BFS_OK;
+  });
+}
+
+void bfs_graph_free(bfs_graph *graph) { delete graph; }
+
+int64_t bfs_graph_num_nodes(const bfs_graph *graph) {
+  return graph == nullptr ? BFS_ERROR_ARGUMENT : graph->graph->num_nodes();
+}
+
+int64_t bfs_graph_num_edges(const bfs_graph *graph) {
+  return graph == nullptr ? BFS_ERROR_ARGUMENT : graph->graph->num_edges();
+}
+
+int bfs_run(bfs_graph *graph, int64_t source, const bfs_options *options,
+            int32_t *depths, int32_t *parents) {
+  if (graph == nullptr) return BFS_ERROR_ARGUMENT;
+
+  // size tells the options of other library versions apart
+  if (options != nullptr && options->size != sizeof(bfs_options))
+    return BFS_ERROR_ARGUMENT;
+
+  BfsOptions cpp_options;
+  if (options != nullptr) {
+    cpp_options.method      = bfs_method(options->method);
+    cpp_options.num_threads = options->num_threads;
+  }
+
+  return Guarded(
+      [&] { return graph->graph->run(source, cpp_options, depths, parents); });
+}
+}
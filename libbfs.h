@@ -0,0 +1,64 @@
+#ifndef LIBBFS_H
+#define LIBBFS_H
+
+/*
+ * C ABI of libbfs. Graphs are opaque handles, results go to buffers the caller
+ * owns, every call returns one of the BFS_* status codes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BFS_OK             0
+#define BFS_ERROR_ARGUMENT -1 /* bad handle, vertex, method or edge */
+#define BFS_ERROR_IO       -2 /* unreadable, malformed or unknown file */
+#define BFS_ERROR_INTERNAL -3 /* out of memory or another library failure */
+
+enum bfs_method {
+  BFS_TOP_DOWN   = 0,
+  BFS_BOTTOM_UP  = 1,
+  BFS_HYBRID     = 2,
+  BFS_LOCAL      = 3,
+  BFS_PERSISTENT = 4,
+};
+
+typedef struct bfs_graph bfs_graph;
+
+typedef struct bfs_options {
+  uint32_t size;        /* sizeof(bfs_options), set by bfs_options_init */
+  int32_t  method;      /* enum bfs_method */
+  int32_t  num_threads; /* 0 for the OpenMP default */
+} bfs_options;
+
+/* hybrid traversal on the default thread count */
+void bfs_options_init(bfs_options *options);
+
+/* .mm, .txt or .bin file, the text formats are symmetrized unless directed */
+int bfs_graph_load(const char *filename, int directed, bfs_graph **graph);
+
+/* num_edges edges src[i] -> dst[i] between the vertices [0, num_nodes) */
+int bfs_graph_from_edges(int64_t num_nodes, const int64_t *src,
+                         const int64_t *dst, size_t num_edges, int directed,
+                         bfs_graph **graph);
+
+void    bfs_graph_free(bfs_graph *graph);
+int64_t bfs_graph_num_nodes(const bfs_graph *graph);
+int64_t bfs_graph_num_edges(const bfs_graph *graph);
+
+/*
+ * Traversal from source. depths and parents take num_nodes entries each, -1
+ * for unreached vertices and for the parent of source, either may be NULL when
+ * it is not wanted. A graph runs one traversal at a time.
+ */
+int bfs_run(bfs_graph *graph, int64_t source, const bfs_options *options,
+            int32_t *depths, int32_t *parents);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
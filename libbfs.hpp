@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "libbfs.h"
+
+/**
+ * @brief Traversal settings of one BfsGraph::run
+ */
+struct BfsOptions {
+  bfs_method method{BFS_HYBRID};
+  int        num_threads{0};  // 0 for the OpenMP default
+};
+
+/**
+ * @brief Graph handle of libbfs. The kernels are instantiated inside the
+ * library, callers only see this interface. Every handle keeps the scratch of
+ * its traversals, so it runs one traversal at a time and repeated runs
+ * allocate nothing.
+ */
+class BfsGraph {
+public:
+  virtual ~BfsGraph() = default;
+
+  virtual std::size_t num_nodes() const = 0;
+  virtual std::size_t num_edges() const = 0;
+
+  /**
+   * @brief Traversal from source into the caller's buffers of num_nodes()
+   * entries, either may be null. Returns a BFS_* status code.
+   */
+  virtual int run(int64_t source, const BfsOptions &options, int32_t *depths,
+                  int32_t *parents) = 0;
+};
+
+/**
+ * @brief Load a .mm, .txt or .bin file into graph, returns a BFS_* status code
+ */
+int BfsGraphLoad(const std::string &filename, bool directed,
+                 std::unique_ptr<BfsGraph> &graph);
+
+/**
+ * @brief Build graph from the edges src[i] -> dst[i], returns a BFS_* status
+ * code
+ */
+int BfsGraphFromEdges(int64_t num_nodes, const int64_t *src,
+                      const int64_t *dst, std::size_t num_edges, bool directed,
+                      std::unique_ptr<BfsGraph> &graph);
@@ -1,78 +1,416 @@
 #include <cstdio>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
+#include <tbb/global_control.h>
+
+#include "batch.hpp"
 #include "bfs.hpp"
+#include "bidirectional.hpp"
 #include "common.h"
+#include "compressed.hpp"
 #include "graph.hpp"
+#include "msbfs.hpp"
+#include "reorder.hpp"
+#include "sparse.hpp"
 
 #undef NDEBUG
 
-Graph G;
+/**
+ * @brief Run one traversal with the selected method, returns the time in ms
+ */
+template <Backend B, typename GraphT>
+float RunBfsOn(const GraphT &G, typename GraphT::vertex_type source_node,
+               int bfs_method, SolutionOf<GraphT> &sol,
+               WorkspaceOf<GraphT> &ws) {
+  Event bfs_event;
 
-// global edges
-std::vector<std::pair<int, int>> edges;
+  switch (bfs_method) {
+    case 0:
+      BfsTopDown<B>(G, source_node, sol, ws);
+      break;
+    case 1:
+      BfsBottomUp<B>(G, source_node, sol, ws);
+      break;
+    case 2:
+      BfsHybrid<B>(G, source_node, sol, ws);
+      break;
+    case 3: {
+      // the visits are written into sol outside of the timing
+      VisitsOf<GraphT> visits;
+      BfsLocal<B>(G, source_node, visits, sol, ws);
+      const float exe_time = bfs_event.end();
+      ScatterVisits(visits, G.get_num_nodes(), source_node, sol);
+      return exe_time;
+    }
+    case 4:
+      // one parallel region, the backend does not apply
+      BfsTopDownPersistent(G, source_node, sol, ws);
+      break;
+    default:
+      Error("no bfs method exists");
+      exit(-1);
+  }
 
-int main(int argc, char **argv) {
-  spdlog::set_pattern("\% %v");
-  // Although the input graph is directed, we'll treat is as undirected graph to
-  // traverse.
+  return bfs_event.end();
+}
 
-  // reference: https://math.nist.gov/MatrixMarket/mmio/c/example_read.c
-  if (argc != 5) {
-    Error(
-        "bfs [source_node] [graph_file].[mm|txt] [omp_num_threads] "
-        "[bfs_method]");
-    exit(-1);
-  }
+template <typename GraphT>
+float RunBfs(const GraphT &G, typename GraphT::vertex_type source_node,
+             int bfs_method, Backend backend, SolutionOf<GraphT> &sol,
+             WorkspaceOf<GraphT> &ws) {
+  if (backend == Backend::kTbb)
+    return RunBfsOn<Backend::kTbb>(G, source_node, bfs_method, sol, ws);
+  return RunBfsOn<Backend::kOpenMP>(G, source_node, bfs_method, sol, ws);
+}
 
-  const int source_node = std::atoi(argv[1]);
-  const int num_threads = std::atoi(argv[3]);
-  omp_set_dynamic(0);
-  omp_set_num_threads(num_threads);
+/**
+ * @brief Run the same traversal repeat times on one solution and workspace,
+ * returns the mean time in ms
+ */
+template <typename GraphT>
+float RunBfsRepeated(const GraphT &G, typename GraphT::vertex_type source_node,
+                     int bfs_method, Backend backend, int repeat,
+                     SolutionOf<GraphT> &sol, WorkspaceOf<GraphT> &ws) {
+  float total = 0;
+  for (int i = 0; i < repeat; ++i)
+    total += RunBfs(G, source_node, bfs_method, backend, sol, ws);
+  return total / repeat;
+}
 
-  const int bfs_method = std::atoi(argv[4]);
+/**
+ * @brief Measure the traversal under every ordering, the graph is restored to
+ * its original labels after each one. The workspace is shared by all runs.
+ */
+template <typename GraphT>
+void CompareOrderings(GraphT &G, typename GraphT::vertex_type source_node,
+                      int bfs_method, Backend backend) {
+  WorkspaceOf<GraphT> ws(G.get_num_nodes());
+  for (const auto ordering : {Ordering::kNone, Ordering::kDegree,
+                              Ordering::kRcm, Ordering::kGorder}) {
+    const auto         reordering = ReorderGraph(G, ordering);
+    SolutionOf<GraphT> sol;
+    const auto         exe_time = RunBfs(G, reordering.to_new(source_node),
+                                         bfs_method, backend, sol, ws);
+    Info("ordering {}: {:.4f} ms, MTEPS: {:.4f}", OrderingName(ordering),
+         exe_time, G.num_edges / (exe_time * 1e6 * 1e-3));
+    if (!reordering.empty()) G.permute(reordering.old_id);
+  }
+}
 
-  const auto filename = std::string(argv[2]);
-  if (filename.ends_with(".mm")) {
-    GraphFromMM(argv[2], G);
-  } else if (filename.ends_with(".txt")) {
-    GraphFromTxt(argv[2], G, edges);
+/**
+ * @brief Answer the queries from sources together with MS-BFS, or as
+ * concurrent independent traversals with query_threads > 0 threads each, or a
+ * number picked from the graph size with 0. ids are the original ids of
+ * the sources to print.
+ */
+template <typename GraphT>
+void RunBatch(const GraphT                                    &G,
+              const std::vector<typename GraphT::vertex_type> &sources,
+              const std::vector<uint64_t>                     &ids,
+              bool                                             concurrent,
+              int                                              query_threads,
+              bool                                             print) {
+  Event                   batch_event;
+  std::vector<MsBfsStats> stats(sources.size());
+  if (concurrent) {
+    BfsBatch(G, sources, omp_get_max_threads(), query_threads,
+             [&](std::size_t i, const SolutionOf<GraphT> &sol) {
+               auto &s = stats[i];
+               for (std::size_t v = 0; v < sol.distance.size(); ++v) {
+                 if (!sol.visited(v)) continue;
+                 ++s.reached;
+                 s.depth_sum += sol.depth(v);
+                 s.eccentricity = std::max(s.eccentricity, sol.depth(v));
+               }
+             });
   } else {
-    Error("filename suffix not matched");
+    MsBfsWorkspaceOf<GraphT> ws(G.get_num_nodes());
+    stats = MsBfsStatistics(G, sources, ws);
+  }
+  const float exe_time = batch_event.end();
+
+  Info("Time: {} ms for {} sources, {:.4f} ms per query", exe_time,
+       sources.size(), exe_time / sources.size());
+  const auto MTEPS = G.num_edges * sources.size() / (exe_time * 1e6 * 1e-3);
+  Info("MTEPS: {:.4f}", MTEPS);
+  printf("%.4f %.4f\n", exe_time, MTEPS);
+
+  if (print) {
+    for (std::size_t i = 0; i < sources.size(); ++i)
+      std::cout << ids[i] << " " << stats[i].reached << " "
+                << stats[i].depth_sum << " " << stats[i].eccentricity
+                << std::endl;
+  }
+}
+
+/**
+ * @brief Distance from source to target with a bidirectional search, prints
+ * the original ids of a shortest path with print
+ */
+template <typename GraphT, typename VertexT>
+void RunPointToPoint(const GraphT &G, VertexT source, VertexT target,
+                     const Reordering<VertexT> &reordering, const IdMap &ids,
+                     bool print) {
+  BidirectionalWorkspaceOf<GraphT> ws;
+
+  Event       path_event;
+  const auto  query    = BfsBidirectional(G, source, target, ws, print);
+  const float exe_time = path_event.end();
+
+  Info("Time: {} ms", exe_time);
+  Info("distance: {}", query.distance);
+  Info("checked edges: {} of {} ({:.4f}%)", query.num_checked_edges,
+       G.num_edges, 100.0 * query.num_checked_edges / G.num_edges);
+  printf("%.4f %d\n", exe_time, query.distance);
+
+  if (print) {
+    for (const VertexT v : query.path) {
+      const VertexT old_v = reordering.empty() ? v : reordering.old_id[v];
+      std::cout << ids.to_original(old_v) << std::endl;
+    }
+  }
+}
+
+/**
+ * @brief Traversal from source bounded by limits, prints the original ids and
+ * depths of the discovered vertices only with print
+ */
+template <typename GraphT, typename VertexT>
+void RunBounded(const GraphT &G, VertexT source, const BfsLimits &limits,
+                const Reordering<VertexT> &reordering, const IdMap &ids,
+                bool print) {
+  VisitsOf<GraphT> visits;
+
+  Event       bounded_event;
+  const auto  num_checked_edges = BfsBounded(G, source, limits, visits);
+  const float exe_time          = bounded_event.end();
+
+  Info("Time: {} ms", exe_time);
+  Info("discovered: {}", visits.size());
+  Info("checked edges: {} of {}", num_checked_edges, G.num_edges);
+  printf("%.4f %zu\n", exe_time, visits.size());
+
+  if (print) {
+    for (const auto &visit : visits) {
+      const VertexT v     = visit.vertex;
+      const VertexT old_v = reordering.empty() ? v : reordering.old_id[v];
+      std::cout << ids.to_original(old_v) << " " << visit.depth << std::endl;
+    }
+  }
+}
+
+/**
+ * @brief Dense id of the source vertex given on the command line, checked
+ * against the num_nodes vertices of the loaded graph
+ */
+int64_t SourceNode(const Arguments &args, const IdMap &ids,
+                   int64_t num_nodes) {
+  const auto source_node = ids.to_dense(std::stoull(args.positional[1]));
+  if (source_node < 0 || source_node >= num_nodes) {
+    Error("source node {} is not in the graph", args.positional[1]);
     exit(-1);
   }
 
-  Solution sol;
-  Event    bfs_event;
+  return source_node;
+}
 
-  switch (bfs_method) {
-    case 0:
-      BfsTopDown(G, source_node, sol);
-      break;
-    case 1:
-      BfsBottomUp(G, source_node, sol);
-      break;
-    case 2:
-      BfsHybrid(G, source_node, sol);
-      break;
-    default:
-      Error("no bfs method exists");
+/**
+ * @brief The traversal selected on the command line, on the plain CSR or on
+ * its compressed form. source_node is the dense id before reordering.
+ */
+template <typename GraphT, typename VertexT>
+void RunQueries(const GraphT &G, int64_t source_node,
+                const Reordering<VertexT> &reordering, const IdMap &ids,
+                const Arguments &args) {
+  const int  bfs_method = std::stoi(args.positional[4]);
+  const auto backend    = BackendFromName(args.get("backend", "omp"));
+  const auto source     = reordering.to_new(source_node);
+  const auto num_nodes  = G.get_num_nodes();
+  const auto num_edges  = G.num_edges;
+
+  // --max-depth=d and --max-vertices=k stop the traversal early
+  if (args.has("max-depth") || args.has("max-vertices")) {
+    BfsLimits limits;
+    if (args.has("max-depth"))
+      limits.max_depth = std::stoi(args.get("max-depth"));
+    if (args.has("max-vertices"))
+      limits.max_vertices = std::stoull(args.get("max-vertices"));
+
+    RunBounded(G, source, limits, reordering, ids, args.has("print"));
+    return;
+  }
+
+  // --target=t answers the distance from source_node to t only
+  if (args.has("target")) {
+    const auto target_node = ids.to_dense(std::stoull(args.get("target")));
+    if (target_node < 0 || target_node >= num_nodes) {
+      Error("target node {} is not in the graph", args.get("target"));
       exit(-1);
+    }
+
+    const auto target = reordering.to_new(target_node);
+    RunPointToPoint(G, source, target, reordering, ids, args.has("print"));
+    return;
   }
 
-  auto       num_edges = G.num_edges;
-  const auto exe_time  = bfs_event.end();
+  // --batch=k queries source_node and the k - 1 vertices after it at once,
+  // --concurrent[=t] runs them as independent traversals of t threads each
+  if (args.has("batch")) {
+    const std::size_t batch = std::stoull(args.get("batch"));
+
+    std::vector<typename GraphT::vertex_type> sources;
+    std::vector<uint64_t>                     original_ids;
+    for (std::size_t i = 0; i < batch; ++i) {
+      const auto v = (source_node + i) % num_nodes;
+      sources.push_back(reordering.to_new(v));
+      original_ids.push_back(ids.to_original(v));
+    }
+
+    const bool concurrent    = args.has("concurrent");
+    const auto threads       = args.get("concurrent");
+    const int  query_threads = threads.empty() ? 0 : std::stoi(threads);
+    RunBatch(G, sources, original_ids, concurrent, query_threads,
+             args.has("print"));
+    return;
+  }
+
+  // repeated traversals on one solution, stamped ones skip the reset
+  const int repeat = std::stoi(args.get("repeat", "1"));
+
+  SolutionOf<GraphT>  sol;
+  WorkspaceOf<GraphT> ws(num_nodes);
+  sol.stamped = args.has("epochs");
+  const float exe_time =
+      RunBfsRepeated(G, source, bfs_method, backend, repeat, sol, ws);
+  RestoreOrder(reordering, sol);
+
   Info("Time: {} ms", exe_time);
-  Info("num_nodes: {}", G.get_num_nodes());
+  Info("num_nodes: {}", num_nodes);
   Info("num_edges: {}", num_edges);
 
   const auto MTEPS = num_edges / (exe_time * 1e6 * 1e-3);
   Info("MTEPS: {:.4f}", MTEPS);
   printf("%.4f %.4f\n", exe_time, MTEPS);
 
-#if 0
-  for (std::size_t i = 1; i < sol.distance.size(); ++i)
-    std::cout << i << " " << sol.distance[i] << std::endl;
-#endif
-}
\ No newline at end of file
+  if (args.has("print")) {
+    for (std::size_t i = 0; i < sol.distance.size(); ++i)
+      std::cout << ids.to_original(i) << " " << sol.depth(i) << std::endl;
+  }
+}
+
+template <typename GraphT>
+void Run(const Arguments &args) {
+  const auto &argv       = args.positional;
+  const int   bfs_method = std::stoi(argv[4]);
+  const bool  directed   = args.has("directed");
+  const auto  backend    = BackendFromName(args.get("backend", "omp"));
+
+  // original vertex ids of graphs written by bfs-convert
+  const IdMap ids = args.has("ids") ? IdMap(args.get("ids")) : IdMap();
+
+  GraphT G;
+  GraphFromFile(argv[2], G, directed);
+
+  const auto source_node = SourceNode(args, ids, G.get_num_nodes());
+
+  if (args.has("dedup")) {
+    Event      dedup_event;
+    const auto removed = G.deduplicate();
+    Info("dedup: removed {} duplicate edges in {:.4f} ms, {} edges left",
+         removed, dedup_event.end(), G.num_edges);
+  }
+
+  // dump the CSR for later runs to map it directly
+  if (argv.size() == 6) GraphToBin(argv[5], G);
+
+  const auto ordering_name = args.get("reorder", "none");
+  if (ordering_name == "compare") {
+    CompareOrderings(G, source_node, bfs_method, backend);
+    return;
+  }
+
+  const auto reordering = ReorderGraph(G, OrderingFromName(ordering_name));
+  if (args.has("compress")) {
+    // traverse the encoded lists only, the plain CSR is released first
+    const auto C = CompressGraph(G);
+    G            = GraphT();
+    RunQueries(C, source_node, reordering, ids, args);
+  } else {
+    RunQueries(G, source_node, reordering, ids, args);
+  }
+}
+
+/**
+ * @brief Traversal on a .cbin file written by bfs-convert, the lists are
+ * decoded from the mapping and no plain CSR is ever built
+ */
+void RunCompressedFile(const Arguments &args) {
+  using vertex_type = SmallGraph::vertex_type;
+
+  if (args.positional.size() == 6 || args.has("dedup") || args.has("reorder")) {
+    Error("a .cbin graph cannot be deduplicated, reordered or dumped");
+    exit(-1);
+  }
+
+  const IdMap ids = args.has("ids") ? IdMap(args.get("ids")) : IdMap();
+
+  CompressedGraph<vertex_type> C;
+  CompressedGraphFromBin(args.positional[2], C);
+
+  const auto source_node = SourceNode(args, ids, C.get_num_nodes());
+  Info("mapped {} compressed bytes", C.memory_bytes());
+  RunQueries(C, source_node, Reordering<vertex_type>(), ids, args);
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_pattern("\% %v");
+  // Unless --directed is given, the input graph is treated as undirected graph
+  // to traverse.
+
+  // reference: https://math.nist.gov/MatrixMarket/mmio/c/example_read.c
+  const Arguments args(argc, argv);
+  constexpr auto usage =
+      "bfs [source_node] [graph_file].[mm|txt|bin|cbin] [omp_num_threads] "
+      "[bfs_method] [(optional) dump_file].bin [--directed] [--dedup] "
+      "[--ids=graph.ids] [--print] [--compress] [--repeat=n] [--epochs] "
+      "[--reorder=none|degree|rcm|gorder|compare] [--backend=omp|tbb] "
+      "[--batch=k] [--concurrent[=threads_per_query]] [--target=t] "
+      "[--max-depth=d] [--max-vertices=k]";
+  if (args.positional.size() != 5 && args.positional.size() != 6) {
+    Error("{}", usage);
+    exit(-1);
+  }
+
+  // numeric arguments are parsed where they are used, std::stoi and
+  // std::stoull throw on text that is not a number or out of range
+  try {
+    const int num_threads = std::stoi(args.positional[3]);
+    omp_set_dynamic(0);
+    omp_set_num_threads(num_threads);
+    // the same thread count for the TBB backend and the parallel algorithms
+    tbb::global_control tbb_threads(
+        tbb::global_control::max_allowed_parallelism, num_threads);
+
+    // 32-bit CSR offsets unless the input may exceed them
+    if (args.positional[2].ends_with(".cbin")) {
+      RunCompressedFile(args);
+    } else if (GraphNeedsLargeOffsets(args.positional[2])) {
+      Run<LargeGraph>(args);
+    } else {
+      Run<SmallGraph>(args);
+    }
+  } catch (const GraphFileError &e) {
+    Error("{}", e.what());
+    exit(-1);
+  } catch (const std::invalid_argument &) {
+    Error("a numeric argument is not a number");
+    Error("{}", usage);
+    exit(-1);
+  } catch (const std::out_of_range &) {
+    Error("a numeric argument is out of range");
+    Error("{}", usage);
+    exit(-1);
+  }
+}
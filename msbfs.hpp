@@ -0,0 +1,255 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <vector>
+
+#include "bfs.hpp"
+#include "common.h"
+#include "graph.hpp"
+
+// sources traversed together, one bit of a lane mask each
+constexpr std::size_t kMsBfsLanes = 64;
+
+/**
+ * @brief Lane masks of a multi-source traversal, bit i of the word of v
+ * belongs to the i-th source of the batch. Sized once per graph and reused by
+ * every batch.
+ */
+template <typename VertexT>
+struct MsBfsWorkspace {
+  MsBfsWorkspace() = default;
+  MsBfsWorkspace(std::size_t n) { prepare(n); }
+
+  void prepare(std::size_t n) {
+    if (n == num_nodes && frontier.data != nullptr) return;
+
+    num_nodes    = n;
+    seen         = std::vector<uint64_t>(n, 0);
+    visit        = std::vector<uint64_t>(n, 0);
+    next         = std::vector<uint64_t>(n, 0);
+    frontier     = Frontier<VertexT>(n + 1);
+    new_frontier = Frontier<VertexT>(n + 1);
+  }
+
+  std::vector<uint64_t> seen;   // lanes that reached v
+  std::vector<uint64_t> visit;  // lanes with v in their frontier
+  std::vector<uint64_t> next;   // all zero between steps
+  Frontier<VertexT>     frontier;
+  Frontier<VertexT>     new_frontier;  // vertices with a lane in visit
+  std::size_t           num_nodes{0};
+};
+
+template <typename GraphT>
+using MsBfsWorkspaceOf = MsBfsWorkspace<typename GraphT::vertex_type>;
+
+/**
+ * @brief Bit-parallel traversal from up to kMsBfsLanes sources at once
+ * (MS-BFS, Then et al., VLDB 2015). A vertex is expanded once per level for
+ * all the lanes that have it in their frontier, so one pass over its neighbor
+ * list serves every query of the batch.
+ *
+ * Levels are pushed from the frontier with an atomic or into next, or pulled
+ * by every vertex some lane has not reached yet once the frontier edges exceed
+ * m_u / alpha, with m_u the edges of those vertices. on_reach(v, lanes, depth)
+ * is called once per vertex and level with the lanes reaching v at depth, from
+ * inside the parallel loops. Returns the number of levels.
+ */
+template <Graph GraphT, typename OnReach>
+inline int MsBfsBatch(const GraphT &G,
+                      const typename GraphT::vertex_type *sources,
+                      std::size_t num_sources, MsBfsWorkspaceOf<GraphT> &ws,
+                      OnReach &&on_reach) {
+  using vertex_type = typename GraphT::vertex_type;
+  assert(num_sources <= kMsBfsLanes);
+
+  constexpr int     alpha = 14;
+  const std::size_t n     = G.get_num_nodes();
+  const uint64_t    all_lanes = num_sources == kMsBfsLanes
+                                    ? ~uint64_t(0)
+                                    : (uint64_t(1) << num_sources) - 1;
+
+  ws.prepare(n);
+  std::fill(std::execution::par_unseq, ws.seen.begin(), ws.seen.end(), 0);
+  std::fill(std::execution::par_unseq, ws.visit.begin(), ws.visit.end(), 0);
+
+  FrontierOf<GraphT> *frontier     = &ws.frontier;
+  FrontierOf<GraphT> *new_frontier = &ws.new_frontier;
+  frontier->clear();
+
+  // m_u: edges of the vertices some lane has not reached yet
+  std::size_t m_f = 0;
+  std::size_t m_u = G.num_edges;
+
+  // a source given twice is one frontier vertex with two lanes
+  for (std::size_t i = 0; i < num_sources; ++i) {
+    const vertex_type s = sources[i];
+    if (ws.visit[s] == 0) {
+      frontier->push_back(s);
+      m_f += G.get_num_edges(s);
+    }
+    ws.visit[s] |= uint64_t(1) << i;
+    ws.seen[s] = ws.visit[s];
+  }
+  for (std::size_t i = 0; i < frontier->size; ++i) {
+    const vertex_type s = frontier->data[i];
+    if (ws.seen[s] == all_lanes) m_u -= G.get_num_edges(s);
+    on_reach(s, ws.visit[s], 0);
+  }
+
+  uint64_t       *seen  = ws.seen.data();
+  const uint64_t *visit = ws.visit.data();
+  uint64_t       *next  = ws.next.data();
+
+  int depth = 0;
+  while (frontier->size != 0) {
+    new_frontier->clear();
+    if (m_f < m_u / alpha) {
+#pragma omp parallel
+      {
+        FrontierBuffer<vertex_type> buffer(new_frontier);
+
+#pragma omp for schedule(dynamic, 64) nowait
+        for (std::size_t i = 0; i < frontier->size; ++i) {
+          const vertex_type u     = frontier->data[i];
+          const uint64_t    lanes = visit[u];
+          for (const vertex_type v : G.neighbors(u)) {
+            const uint64_t reach = lanes & ~seen[v];
+            // the first lane to reach v queues it
+            if (reach != 0 && __sync_fetch_and_or(&next[v], reach) == 0)
+              buffer.push_back(v);
+          }
+        }
+      }
+    } else {
+#pragma omp parallel
+      {
+        FrontierBuffer<vertex_type> buffer(new_frontier);
+
+#pragma omp for schedule(dynamic, 1024) nowait
+        for (std::size_t v = 0; v < n; ++v) {
+          const uint64_t unseen = all_lanes & ~seen[v];
+          if (unseen == 0) continue;
+
+          uint64_t lanes = 0;
+          for (const vertex_type u : G.in_neighbors(v)) {
+            lanes |= visit[u];
+            if ((lanes & unseen) == unseen) break;
+          }
+
+          next[v] = lanes & unseen;
+          if (next[v] != 0) buffer.push_back(v);
+        }
+      }
+    }
+
+    // the new lanes become seen, the expanded ones are cleared from visit so
+    // that it can serve as next
+    std::size_t finished = 0;
+    m_f                  = 0;
+#pragma omp parallel for reduction(+ : m_f, finished)
+    for (std::size_t i = 0; i < new_frontier->size; ++i) {
+      const vertex_type v      = new_frontier->data[i];
+      const std::size_t degree = G.get_num_edges(v);
+      seen[v] |= next[v];
+      m_f += degree;
+      if (seen[v] == all_lanes) finished += degree;
+      on_reach(v, next[v], depth + 1);
+    }
+    m_u -= finished;
+
+#pragma omp parallel for
+    for (std::size_t i = 0; i < frontier->size; ++i)
+      ws.visit[frontier->data[i]] = 0;
+
+    std::swap(ws.visit, ws.next);
+    visit = ws.visit.data();
+    next  = ws.next.data();
+    std::swap(frontier, new_frontier);
+    ++depth;
+  }
+
+  return depth;
+}
+
+/**
+ * @brief Depth of every vertex from every source, depths[i][v] is NOT_VISITED
+ * when v is unreachable from sources[i]. The sources run in batches of
+ * kMsBfsLanes.
+ */
+template <Graph GraphT>
+inline void MsBfsDepths(
+    const GraphT &G, const std::vector<typename GraphT::vertex_type> &sources,
+    std::vector<std::vector<int>> &depths, MsBfsWorkspaceOf<GraphT> &ws) {
+  const std::size_t n = G.get_num_nodes();
+  depths.resize(sources.size());
+
+  for (std::size_t first = 0; first < sources.size(); first += kMsBfsLanes) {
+    const std::size_t count = std::min(kMsBfsLanes, sources.size() - first);
+    for (std::size_t i = first; i < first + count; ++i)
+      depths[i].assign(n, NOT_VISITED);
+
+    // every call owns v, the writes never collide
+    MsBfsBatch(G, sources.data() + first, count, ws,
+               [&](std::size_t v, uint64_t lanes, int depth) {
+                 for (; lanes != 0; lanes &= lanes - 1)
+                   depths[first + __builtin_ctzll(lanes)][v] = depth;
+               });
+  }
+}
+
+/**
+ * @brief Aggregates of one source, without the O(n) depth array
+ */
+struct MsBfsStats {
+  std::size_t reached{0};    // including the source
+  uint64_t    depth_sum{0};  // sum of the depths of the reached vertices
+  int         eccentricity{0};
+};
+
+/**
+ * @brief Reached vertices, depth sum and eccentricity of every source, e.g.
+ * for closeness centrality. Every thread sums its own copy of the batch.
+ */
+template <Graph GraphT>
+inline std::vector<MsBfsStats> MsBfsStatistics(
+    const GraphT &G, const std::vector<typename GraphT::vertex_type> &sources,
+    MsBfsWorkspaceOf<GraphT> &ws) {
+  using BatchStats = std::array<MsBfsStats, kMsBfsLanes>;
+
+  std::vector<MsBfsStats> stats(sources.size());
+  std::vector<BatchStats> local(omp_get_max_threads());
+
+  for (std::size_t first = 0; first < sources.size(); first += kMsBfsLanes) {
+    const std::size_t count = std::min(kMsBfsLanes, sources.size() - first);
+    std::fill(local.begin(), local.end(), BatchStats());
+
+    MsBfsBatch(G, sources.data() + first, count, ws,
+               [&](std::size_t, uint64_t lanes, int depth) {
+                 auto &batch = local[omp_get_thread_num()];
+                 for (; lanes != 0; lanes &= lanes - 1) {
+                   auto &s = batch[__builtin_ctzll(lanes)];
+                   ++s.reached;
+                   s.depth_sum += depth;
+                   s.eccentricity = std::max(s.eccentricity, depth);
+                 }
+               });
+
+    for (const auto &batch : local) {
+      for (std::size_t i = 0; i < count; ++i) {
+        auto &s = stats[first + i];
+        s.reached += batch[i].reached;
+        s.depth_sum += batch[i].depth_sum;
+        s.eccentricity = std::max(s.eccentricity, batch[i].eccentricity);
+      }
+    }
+  }
+
+  return stats;
+}
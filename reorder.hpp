@@ -0,0 +1,308 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "bfs.hpp"
+#include "common.h"
+#include "graph.hpp"
+
+/**
+ * @brief Vertex orderings applied before traversal to improve the locality of
+ * the distance/parent accesses
+ */
+enum class Ordering {
+  kNone,
+  kDegree,  // hub-first degree sort
+  kRcm,     // reverse Cuthill-McKee
+  kGorder,  // windowed Gorder
+};
+
+inline Ordering OrderingFromName(const std::string &name) {
+  if (name == "none") return Ordering::kNone;
+  if (name == "degree") return Ordering::kDegree;
+  if (name == "rcm") return Ordering::kRcm;
+  if (name == "gorder") return Ordering::kGorder;
+  Error("unknown ordering {}, expected none|degree|rcm|gorder", name);
+  exit(-1);
+}
+
+inline const char *OrderingName(Ordering ordering) {
+  switch (ordering) {
+    case Ordering::kNone:
+      return "none";
+    case Ordering::kDegree:
+      return "degree";
+    case Ordering::kRcm:
+      return "rcm";
+    case Ordering::kGorder:
+      return "gorder";
+  }
+
+  return "";
+}
+
+/**
+ * @brief Permutation applied to a graph, kept to map results back to the ids
+ * before reordering
+ */
+template <typename VertexT>
+struct Reordering {
+  std::vector<VertexT> new_id;  // indexed by the original id
+  std::vector<VertexT> old_id;  // indexed by the new id
+
+  FORCEINLINE bool    empty() const { return new_id.empty(); }
+  FORCEINLINE VertexT to_new(VertexT v) const {
+    return empty() ? v : new_id[v];
+  }
+};
+
+/**
+ * @brief Hub-first order, vertices sorted by decreasing degree
+ */
+template <Graph GraphT>
+inline std::vector<typename GraphT::vertex_type> DegreeOrder(const GraphT &G) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  const vertex_type        n = G.get_num_nodes();
+  std::vector<vertex_type> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(std::execution::par, order.begin(), order.end(),
+                   [&G](vertex_type a, vertex_type b) {
+                     return G.get_num_edges(a) > G.get_num_edges(b);
+                   });
+  return order;
+}
+
+/**
+ * @brief Reverse Cuthill-McKee: a BFS from a low degree vertex of every
+ * component, visiting neighbors by increasing degree, then reversed
+ */
+template <Graph GraphT>
+inline std::vector<typename GraphT::vertex_type> RcmOrder(const GraphT &G) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  const vertex_type        n = G.get_num_nodes();
+  std::vector<vertex_type> order;
+  std::vector<vertex_type> neighbors;
+  std::vector<char>        placed(n, 0);
+  order.reserve(n);
+
+  // components are started from the lowest degree vertices first
+  std::vector<vertex_type> starts = DegreeOrder(G);
+  std::reverse(starts.begin(), starts.end());
+
+  auto by_degree = [&G](vertex_type a, vertex_type b) {
+    return G.get_num_edges(a) < G.get_num_edges(b);
+  };
+
+  for (const vertex_type s : starts) {
+    if (placed[s]) continue;
+    std::size_t head = order.size();
+    order.push_back(s);
+    placed[s] = 1;
+    while (head != order.size()) {
+      const vertex_type u = order[head++];
+      neighbors.clear();
+      for (const vertex_type v : G.neighbors(u)) {
+        if (!placed[v]) {
+          placed[v] = 1;
+          neighbors.push_back(v);
+        }
+      }
+
+      std::sort(neighbors.begin(), neighbors.end(), by_degree);
+      order.insert(order.end(), neighbors.begin(), neighbors.end());
+    }
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/**
+ * @brief Max-priority over the unplaced vertices whose keys only change by
+ * one, the unit heap of Gorder. The vertices of one key form a doubly linked
+ * list, so a change is O(1) and the memory stays O(n).
+ */
+template <typename VertexT>
+class UnitHeap {
+public:
+  explicit UnitHeap(VertexT n) : m_key(n, 0), m_prev(n), m_next(n), m_head(1) {
+    m_head[0] = -1;
+    for (VertexT v = 0; v < n; ++v) link(v);
+  }
+
+  /**
+   * @brief A vertex of the largest key, -1 when every key is 0
+   */
+  VertexT top() {
+    while (m_top > 0 && m_head[m_top] < 0) --m_top;
+    return m_top > 0 ? m_head[m_top] : -1;
+  }
+
+  void increment(VertexT v) {
+    if (m_key[v] < 0) return;
+    unlink(v);
+    if (std::size_t(++m_key[v]) == m_head.size()) m_head.push_back(-1);
+    link(v);
+    m_top = std::max(m_top, m_key[v]);
+  }
+
+  void decrement(VertexT v) {
+    if (m_key[v] <= 0) return;
+    unlink(v);
+    --m_key[v];
+    link(v);
+  }
+
+  void remove(VertexT v) {
+    unlink(v);
+    m_key[v] = -1;
+  }
+
+private:
+  void link(VertexT v) {
+    VertexT &head = m_head[m_key[v]];
+    m_prev[v]     = -1;
+    m_next[v]     = head;
+    if (head >= 0) m_prev[head] = v;
+    head = v;
+  }
+
+  void unlink(VertexT v) {
+    if (m_prev[v] >= 0)
+      m_next[m_prev[v]] = m_next[v];
+    else
+      m_head[m_key[v]] = m_next[v];
+    if (m_next[v] >= 0) m_prev[m_next[v]] = m_prev[v];
+  }
+
+  std::vector<int>     m_key;   // -1 once removed
+  std::vector<VertexT> m_prev;
+  std::vector<VertexT> m_next;
+  std::vector<VertexT> m_head;  // first vertex of every key, -1 if none
+  int                  m_top{0};
+};
+
+/**
+ * @brief Windowed Gorder (Wei et al., SIGMOD'16). Vertices are placed greedily
+ * by the number of neighbor and sibling relations they share with the last
+ * window placed ones. Siblings through vertices of more than hub_degree
+ * neighbors are skipped, which bounds the cost on power-law graphs.
+ */
+template <Graph GraphT>
+inline std::vector<typename GraphT::vertex_type> GorderOrder(
+    const GraphT &G, std::size_t window = 5, std::size_t hub_degree = 256) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  const vertex_type        n = G.get_num_nodes();
+  std::vector<vertex_type> order;
+  std::vector<char>        placed(n, 0);
+  UnitHeap<vertex_type>    heap(n);
+  order.reserve(n);
+
+  // scores rise when u enters the window and fall by as much when it leaves
+  auto update = [&](vertex_type u, bool enters) {
+    auto bump = [&](vertex_type v) {
+      if (enters)
+        heap.increment(v);
+      else
+        heap.decrement(v);
+    };
+
+    for (const vertex_type v : G.neighbors(u)) bump(v);
+    for (const vertex_type w : G.in_neighbors(u)) {
+      if (G.get_num_edges(w) > hub_degree) continue;
+      for (const vertex_type v : G.neighbors(w)) bump(v);
+    }
+  };
+
+  // restart from the highest degree unplaced vertex when no score is left
+  const std::vector<vertex_type> starts     = DegreeOrder(G);
+  std::size_t                    next_start = 0;
+
+  while (order.size() != static_cast<std::size_t>(n)) {
+    vertex_type u = heap.top();
+    if (u < 0) {
+      while (placed[starts[next_start]]) ++next_start;
+      u = starts[next_start];
+    }
+
+    heap.remove(u);
+    placed[u] = 1;
+    order.push_back(u);
+    update(u, true);
+    if (order.size() > window) update(order[order.size() - window - 1], false);
+  }
+
+  return order;
+}
+
+/**
+ * @brief Reorder G in place and return the permutation
+ */
+template <Graph GraphT>
+inline Reordering<typename GraphT::vertex_type> ReorderGraph(
+    GraphT &G, Ordering ordering) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  Reordering<vertex_type> reordering;
+  if (ordering == Ordering::kNone) return reordering;
+
+  Event                    reorder_event;
+  std::vector<vertex_type> order;
+  switch (ordering) {
+    case Ordering::kDegree:
+      order = DegreeOrder(G);
+      break;
+    case Ordering::kRcm:
+      order = RcmOrder(G);
+      break;
+    case Ordering::kGorder:
+      order = GorderOrder(G);
+      break;
+    default:
+      break;
+  }
+
+  reordering.old_id = std::move(order);
+  reordering.new_id.resize(reordering.old_id.size());
+#pragma omp parallel for
+  for (std::size_t i = 0; i < reordering.old_id.size(); ++i)
+    reordering.new_id[reordering.old_id[i]] = i;
+
+  G.permute(reordering.new_id);
+  Info("reorder {}: {:.4f} ms", OrderingName(ordering), reorder_event.end());
+  return reordering;
+}
+
+/**
+ * @brief Map a solution computed on the reordered graph back to the original
+ * vertex ids
+ */
+template <typename VertexT>
+inline void RestoreOrder(const Reordering<VertexT> &reordering,
+                         Solution<VertexT> &sol) {
+  if (reordering.empty()) return;
+
+  // the restored distances are depths, stamps start again right above them
+  Solution<VertexT> restored;
+  restored.stamped    = sol.stamped;
+  restored.next_epoch = sol.next_epoch - sol.epoch;
+  restored.distance.resize(sol.distance.size());
+  restored.parent.resize(sol.parent.size());
+#pragma omp parallel for
+  for (std::size_t v = 0; v < reordering.new_id.size(); ++v) {
+    const VertexT p      = sol.parent_of(reordering.new_id[v]);
+    restored.distance[v] = sol.depth(reordering.new_id[v]);
+    restored.parent[v]   = p == NOT_VISITED ? p : reordering.old_id[p];
+  }
+
+  sol = std::move(restored);
+}
@@ -122,6 +122,20 @@ def main():
     plt.tight_layout()
     plt.savefig('report/figures/scalability.pdf')
 
+    # OpenMP schedule(dynamic, 128) against TBB, on 1 and then 8 threads
+    for name in names:
+        for top_down, method in [(0, 'Top-Down'), (2, 'Hybrid')]:
+            row = []
+            for thread in [1, 8]:
+                for prefix in ['result', 'result/tbb']:
+                    result = []
+                    for i in range(1, 11):
+                        result.append(extract_info(
+                            f"{prefix}/{name}-{i}-{thread}-{top_down}.txt"))
+                    row.append(statistics.mean([i.MTEPS for i in result]))
+            print(f'{name} ({method}) & ' +
+                  ' & '.join(f'{i:.4f}' for i in row) + ' \\\\')
+
 
 if __name__ == '__main__':
     font_dir = ['/usr/share/fonts/OTF/']
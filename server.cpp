@@ -0,0 +1,463 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bfs.hpp"
+#include "bidirectional.hpp"
+#include "common.h"
+#include "graph.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "sparse.hpp"
+
+/**
+ * @brief A graph kept resident, name is how queries refer to it and ids maps
+ * its dense ids to the original ones of the input, if it was given
+ */
+template <typename GraphT>
+struct ServedGraph {
+  std::string name;
+  GraphT      G;
+  IdMap       ids;
+};
+
+/**
+ * @brief A graph given on the command line as name=graph_file[:ids_file]
+ */
+struct GraphSpec {
+  std::string name;
+  std::string graph_file;
+  std::string ids_file;
+};
+
+/**
+ * @brief Split a name=graph_file[:ids_file] argument, false if it has no name
+ */
+inline bool ParseGraphSpec(const std::string &arg, GraphSpec &spec) {
+  const auto eq = arg.find('=');
+  if (eq == std::string::npos || eq == 0) return false;
+
+  const auto colon = arg.find(':', eq);
+  spec.name        = arg.substr(0, eq);
+  spec.graph_file  = arg.substr(eq + 1, colon - eq - 1);
+  spec.ids_file    = colon == std::string::npos ? "" : arg.substr(colon + 1);
+  return true;
+}
+
+/**
+ * @brief Scratch of one worker, a stamped solution, a workspace and a visit
+ * list per graph plus the workspace of its point-to-point queries, all reused
+ * by every query the worker answers
+ */
+template <typename GraphT>
+struct WorkerScratch {
+  WorkerScratch(const std::vector<ServedGraph<GraphT>> &graphs)
+      : sols(graphs.size()), visits(graphs.size()), paths(graphs.size()) {
+    for (auto &sol : sols) sol.stamped = true;
+    for (const auto &graph : graphs) ws.emplace_back(graph.G.get_num_nodes());
+  }
+
+  std::vector<SolutionOf<GraphT>>               sols;
+  std::vector<WorkspaceOf<GraphT>>              ws;
+  std::vector<VisitsOf<GraphT>>                 visits;
+  std::vector<BidirectionalWorkspaceOf<GraphT>> paths;
+};
+
+/**
+ * @brief Parse the original id of a vertex of a graph with n vertices into
+ * its dense id, false if it is not one
+ */
+inline bool ParseVertex(const std::string &token, const IdMap &ids,
+                        std::size_t n, int64_t &vertex) {
+  const char *last = token.data() + token.size();
+  uint64_t    id;
+  const auto  res = std::from_chars(token.data(), last, id);
+  if (res.ec != std::errc() || res.ptr != last) return false;
+
+  vertex = ids.to_dense(id);
+  return vertex >= 0 && std::size_t(vertex) < n;
+}
+
+/**
+ * @brief Parse a depth or vertex count, false if it is not a non-negative one
+ */
+inline bool ParseCount(const std::string &token, int64_t &count) {
+  const char *last = token.data() + token.size();
+  const auto  res  = std::from_chars(token.data(), last, count);
+  return res.ec == std::errc() && res.ptr == last && count >= 0;
+}
+
+/**
+ * @brief Parse a thread or worker count, false if it is not a positive one
+ */
+inline bool ParseThreads(const std::string &token, int &count) {
+  const char *last = token.data() + token.size();
+  const auto  res  = std::from_chars(token.data(), last, count);
+  return res.ec == std::errc() && res.ptr == last && count >= 1;
+}
+
+/**
+ * @brief Line protocol over resident graphs, one request per line and one
+ * response line per request. Vertex ids are the original ids of graphs given
+ * with an ids file and dense ids otherwise, in requests and responses alike.
+ *
+ *   graphs               ok <count> (<name> <num_nodes> <num_edges>)...
+ *   bfs <graph> <s>      ok <us> <reached> (<v> <depth>)...
+ *   dist <graph> <s> <t> ok <us> <depth>, -1 when t is unreachable
+ *   path <graph> <s> <t> ok <us> <depth> <s> ... <t>, the vertices of a
+ *                        shortest path
+ *   khop <graph> <s> <k> ok <us> <count> <v>..., the vertices within k hops
+ *   nearest <graph> <s> <k>
+ *                        ok <us> <count> (<v> <depth>)..., the k vertices
+ *                        nearest to s, s included
+ *   hist <graph> <s>     ok <us> <levels> <count at depth 0>...
+ *   quit                 closes the connection
+ *
+ * <us> is the latency of the query in microseconds. Malformed requests get
+ * err <reason>.
+ */
+template <typename GraphT>
+class QueryServer {
+public:
+  using vertex_type = typename GraphT::vertex_type;
+
+  QueryServer(std::vector<ServedGraph<GraphT>> graphs, int query_threads)
+      : m_graphs(std::move(graphs)), m_query_threads(query_threads) {}
+
+  /**
+   * @brief Answer the requests on stdin until quit or end of input
+   */
+  void serve_stdin() {
+    omp_set_num_threads(m_query_threads);
+    WorkerScratch<GraphT> scratch(m_graphs);
+    serve_stream(stdin, stdout, scratch);
+  }
+
+  /**
+   * @brief Answer the requests read from in until quit, end of input or a
+   * failed write to out
+   */
+  void serve_stream(FILE *in, FILE *out, WorkerScratch<GraphT> &scratch) {
+    char       *line     = nullptr;
+    std::size_t capacity = 0;
+    ssize_t     length;
+    while ((length = getline(&line, &capacity, in)) != -1) {
+      std::string request(line, length);
+      while (!request.empty() &&
+             (request.back() == '\n' || request.back() == '\r'))
+        request.pop_back();
+      if (request.empty()) continue;
+      if (request == "quit") break;
+
+      // a client that went away is dropped, the worker moves on
+      const std::string response = answer(request, scratch);
+      if (std::fwrite(response.data(), 1, response.size(), out) !=
+              response.size() ||
+          std::fputc('\n', out) == EOF || std::fflush(out) == EOF)
+        break;
+    }
+
+    std::free(line);
+  }
+
+  /**
+   * @brief Accept clients on a Unix domain socket at path, num_workers threads
+   * serve one connection each at a time. Does not return.
+   */
+  void serve_socket(const std::string &path, int num_workers) {
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (listener < 0 || path.size() >= sizeof(addr.sun_path)) {
+      Error("cannot create socket {}", path);
+      exit(-1);
+    }
+
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    const auto *address = reinterpret_cast<const sockaddr *>(&addr);
+    if (bind(listener, address, sizeof(addr)) < 0 || listen(listener, 64) < 0) {
+      Error("cannot listen on {}: {}", path, std::strerror(errno));
+      exit(-1);
+    }
+
+    Info("listening on {} with {} workers", path, num_workers);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_workers; ++i)
+      workers.emplace_back([this] { worker_loop(); });
+
+    while (true) {
+      const int client = accept(listener, nullptr, nullptr);
+      if (client < 0) continue;
+      {
+        std::lock_guard lock(m_mutex);
+        m_clients.push(client);
+      }
+      m_ready.notify_one();
+    }
+  }
+
+  /**
+   * @brief Response line to one request, without the newline
+   */
+  std::string answer(const std::string &request,
+                     WorkerScratch<GraphT> &scratch) {
+    std::istringstream       tokens(request);
+    std::vector<std::string> args{std::istream_iterator<std::string>(tokens),
+                                  std::istream_iterator<std::string>()};
+    if (args.empty()) return "err empty request";
+
+    const std::string &command = args[0];
+
+    if (command == "graphs") {
+      std::string response = fmt::format("ok {}", m_graphs.size());
+      for (const auto &graph : m_graphs)
+        fmt::format_to(std::back_inserter(response), " {} {} {}", graph.name,
+                       graph.G.get_num_nodes(), graph.G.num_edges);
+      return response;
+    }
+
+    std::size_t num_args = 0;
+    if (command == "bfs" || command == "hist") num_args = 3;
+    if (command == "dist" || command == "path" || command == "khop" ||
+        command == "nearest")
+      num_args = 4;
+    if (num_args == 0) return "err unknown command " + command;
+    if (args.size() != num_args) return "err wrong number of arguments";
+
+    const std::size_t g = find_graph(args[1]);
+    if (g == m_graphs.size()) return "err unknown graph " + args[1];
+
+    const GraphT &G   = m_graphs[g].G;
+    const IdMap  &ids = m_graphs[g].ids;
+    const auto    n   = G.get_num_nodes();
+    int64_t       source, target = 0, k = 0;
+    if (!ParseVertex(args[2], ids, n, source))
+      return "err bad vertex " + args[2];
+    const bool point_to_point = command == "dist" || command == "path";
+    if (point_to_point && !ParseVertex(args[3], ids, n, target))
+      return "err bad vertex " + args[3];
+    const bool bounded = command == "khop" || command == "nearest";
+    if (bounded && !ParseCount(args[3], k)) return "err bad limit " + args[3];
+
+    Event       query_event;
+    std::string response;
+    auto        out = std::back_inserter(response);
+    if (point_to_point) {
+      // both ends grow until they meet, only a fraction of the graph is read
+      const auto query =
+          BfsBidirectional(G, vertex_type(source), vertex_type(target),
+                           scratch.paths[g], command == "path");
+      fmt::format_to(out, " {}", query.distance);
+      for (const vertex_type v : query.path)
+        fmt::format_to(out, " {}", ids.to_original(v));
+      return finish(request, query_event, response);
+    }
+
+    auto &visits = scratch.visits[g];
+    if (bounded) {
+      // stops at the limit, friend-of-friend lookups read a few adjacencies
+      BfsLimits limits;
+      if (command == "khop")
+        limits.max_depth = int(std::min<int64_t>(k, limits.max_depth));
+      else
+        limits.max_vertices = std::size_t(k);
+      BfsBounded(G, vertex_type(source), limits, visits);
+
+      fmt::format_to(out, " {}", visits.size());
+      for (const auto &visit : visits) {
+        fmt::format_to(out, " {}", ids.to_original(visit.vertex));
+        if (command == "nearest") fmt::format_to(out, " {}", visit.depth);
+      }
+      return finish(request, query_event, response);
+    }
+
+    // the other queries are local first, large ones go dense on their own
+    BfsLocal(G, vertex_type(source), visits, scratch.sols[g], scratch.ws[g]);
+
+    if (command == "bfs") {
+      fmt::format_to(out, " {}", visits.size());
+      for (const auto &visit : visits)
+        fmt::format_to(out, " {} {}", ids.to_original(visit.vertex),
+                       visit.depth);
+    } else {
+      std::vector<std::size_t> histogram;
+      for (const auto &visit : visits) {
+        if (std::size_t(visit.depth) >= histogram.size())
+          histogram.resize(visit.depth + 1, 0);
+        ++histogram[visit.depth];
+      }
+      fmt::format_to(out, " {}", histogram.size());
+      for (const std::size_t count : histogram)
+        fmt::format_to(out, " {}", count);
+    }
+
+    return finish(request, query_event, response);
+  }
+
+private:
+  /**
+   * @brief Prefix the response with ok and the latency of the query
+   */
+  static std::string finish(const std::string &request,
+                            const Event       &query_event,
+                            const std::string &response) {
+    const float latency = query_event.end();
+    Info("{} in {:.4f} ms", request, latency);
+    return fmt::format("ok {}{}", int64_t(latency * 1000), response);
+  }
+
+  std::size_t find_graph(const std::string &name) const {
+    std::size_t g = 0;
+    while (g < m_graphs.size() && m_graphs[g].name != name) ++g;
+    return g;
+  }
+
+  void worker_loop() {
+    // the kernels of this worker open regions of m_query_threads threads
+    omp_set_num_threads(m_query_threads);
+    WorkerScratch<GraphT> scratch(m_graphs);
+
+    while (true) {
+      int client;
+      {
+        std::unique_lock lock(m_mutex);
+        m_ready.wait(lock, [this] { return !m_clients.empty(); });
+        client = m_clients.front();
+        m_clients.pop();
+      }
+
+      FILE *in = fdopen(client, "r");
+      if (in == nullptr) {
+        close(client);
+        continue;
+      }
+
+      const int out_fd = dup(client);
+      FILE     *out    = out_fd < 0 ? nullptr : fdopen(out_fd, "w");
+      if (out == nullptr) {
+        if (out_fd >= 0) close(out_fd);
+        std::fclose(in);
+        continue;
+      }
+
+      serve_stream(in, out, scratch);
+      std::fclose(out);
+      std::fclose(in);
+    }
+  }
+
+  std::vector<ServedGraph<GraphT>> m_graphs;
+  int                              m_query_threads;
+
+  std::mutex              m_mutex;
+  std::condition_variable m_ready;
+  std::queue<int>         m_clients;
+};
+
+template <typename GraphT>
+void Serve(const Arguments &args, const std::vector<GraphSpec> &specs,
+           int num_threads, int num_workers) {
+  const bool directed = args.has("directed");
+
+  std::vector<ServedGraph<GraphT>> graphs;
+  for (const auto &spec : specs) {
+    auto &graph = graphs.emplace_back();
+    graph.name  = spec.name;
+    GraphFromFile(spec.graph_file, graph.G, directed);
+    // original vertex ids of graphs written by bfs-convert
+    if (!spec.ids_file.empty()) {
+      graph.ids = IdMap(spec.ids_file);
+      if (graph.ids.size() != std::size_t(graph.G.get_num_nodes())) {
+        Error("{} does not have one id per vertex of {}", spec.ids_file,
+              spec.graph_file);
+        exit(-1);
+      }
+    }
+
+    Info("{}: {} nodes, {} edges", graph.name, graph.G.get_num_nodes(),
+         graph.G.num_edges);
+  }
+
+  // the thread budget is split between the workers
+  const int query_threads = std::max(1, num_threads / num_workers);
+
+  QueryServer<GraphT> server(std::move(graphs), query_threads);
+  if (args.has("socket")) {
+    server.serve_socket(args.get("socket"), num_workers);
+  } else {
+    server.serve_stdin();
+  }
+}
+
+int main(int argc, char **argv) {
+  // stdout carries the responses, the log goes to stderr
+  spdlog::set_default_logger(spdlog::stderr_color_mt("bfs-server"));
+  spdlog::set_pattern("\% %v");
+
+  const Arguments args(argc, argv);
+  if (args.positional.size() < 3) {
+    Error(
+        "bfs-server [omp_num_threads] "
+        "[name]=[graph_file].[mm|txt|bin][:graph.ids]... "
+        "[--directed] [--socket=path] [--workers=n]");
+    exit(-1);
+  }
+
+  int num_threads, num_workers;
+  if (!ParseThreads(args.positional[1], num_threads)) {
+    Error("omp_num_threads must be a number of at least 1");
+    exit(-1);
+  }
+  if (!ParseThreads(args.get("workers", "1"), num_workers)) {
+    Error("--workers must be a number of at least 1");
+    exit(-1);
+  }
+
+  std::vector<GraphSpec> specs(args.positional.size() - 2);
+  for (std::size_t i = 0; i < specs.size(); ++i) {
+    if (!ParseGraphSpec(args.positional[i + 2], specs[i])) {
+      Error("graph {} is not given as name=graph_file[:ids_file]",
+            args.positional[i + 2]);
+      exit(-1);
+    }
+  }
+
+  omp_set_dynamic(0);
+
+  // writes to a closed connection fail with EPIPE instead of ending the server
+  signal(SIGPIPE, SIG_IGN);
+
+  try {
+    // 32-bit CSR offsets unless one of the inputs may exceed them
+    bool large = false;
+    for (const auto &spec : specs)
+      large |= GraphNeedsLargeOffsets(spec.graph_file);
+
+    if (large) {
+      Serve<LargeGraph>(args, specs, num_threads, num_workers);
+    } else {
+      Serve<SmallGraph>(args, specs, num_threads, num_workers);
+    }
+  } catch (const GraphFileError &e) {
+    Error("{}", e.what());
+    exit(-1);
+  }
+
+  return 0;
+}
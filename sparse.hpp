@@ -0,0 +1,251 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bfs.hpp"
+#include "common.h"
+#include "graph.hpp"
+
+/**
+ * @brief Open-addressing hash set of vertex ids with linear probing. The table
+ * grows with the number of inserted vertices, not with the graph.
+ */
+template <typename VertexT>
+class VisitedSet {
+public:
+  VisitedSet(std::size_t capacity = 64)
+      : m_slots(round_up(capacity), kEmpty) {}
+
+  /**
+   * @brief Insert v, returns false if it was already in the set
+   */
+  FORCEINLINE bool insert(VertexT v) {
+    if (2 * (m_size + 1) > m_slots.size()) grow();
+    if (!place(v)) return false;
+    ++m_size;
+    return true;
+  }
+
+  FORCEINLINE bool contains(VertexT v) const {
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = slot(v);; i = (i + 1) & mask) {
+      if (m_slots[i] == v) return true;
+      if (m_slots[i] == kEmpty) return false;
+    }
+  }
+
+  FORCEINLINE std::size_t size() const { return m_size; }
+
+private:
+  static constexpr VertexT kEmpty = -1;
+
+  static std::size_t round_up(std::size_t n) {
+    std::size_t capacity = 16;
+    while (capacity < n) capacity *= 2;
+    return capacity;
+  }
+
+  // Fibonacci hashing, spreads the consecutive ids of a neighbor list
+  FORCEINLINE std::size_t slot(VertexT v) const {
+    return (uint64_t(v) * 0x9e3779b97f4a7c15ull) >> (64 - bits());
+  }
+
+  FORCEINLINE int bits() const { return __builtin_ctzll(m_slots.size()); }
+
+  FORCEINLINE bool place(VertexT v) {
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = slot(v);; i = (i + 1) & mask) {
+      if (m_slots[i] == v) return false;
+      if (m_slots[i] == kEmpty) {
+        m_slots[i] = v;
+        return true;
+      }
+    }
+  }
+
+  void grow() {
+    std::vector<VertexT> old(2 * m_slots.size(), kEmpty);
+    std::swap(old, m_slots);
+    for (const VertexT v : old)
+      if (v != kEmpty) place(v);
+  }
+
+  std::vector<VertexT> m_slots;
+  std::size_t          m_size{0};
+};
+
+/**
+ * @brief One vertex reached by a local query
+ */
+template <typename VertexT>
+struct Visit {
+  VertexT vertex;
+  int     depth;
+  VertexT parent;
+};
+
+template <typename GraphT>
+using VisitsOf = std::vector<Visit<typename GraphT::vertex_type>>;
+
+/**
+ * @brief Every vertex reached in a dense solution as a visit list, in vertex
+ * order
+ */
+template <typename VertexT>
+inline void CollectVisits(const Solution<VertexT> &sol,
+                          std::vector<Visit<VertexT>> &visits) {
+  const std::size_t                        n = sol.distance.size();
+  std::vector<std::vector<Visit<VertexT>>> chunks(omp_get_max_threads());
+#pragma omp parallel
+  {
+    auto &chunk = chunks[omp_get_thread_num()];
+#pragma omp for schedule(static)
+    for (std::size_t v = 0; v < n; ++v) {
+      if (sol.visited(v))
+        chunk.push_back({VertexT(v), sol.depth(v), sol.parent_of(v)});
+    }
+  }
+
+  visits.clear();
+  for (const auto &chunk : chunks)
+    visits.insert(visits.end(), chunk.begin(), chunk.end());
+}
+
+/**
+ * @brief Write a visit list into sol, unreached vertices read as not visited
+ */
+template <typename VertexT>
+inline void ScatterVisits(const std::vector<Visit<VertexT>> &visits,
+                          std::size_t n, VertexT source_node,
+                          Solution<VertexT> &sol) {
+  ResetSolution(n, source_node, sol);
+  int max_depth = 0;
+  for (const auto &visit : visits) {
+    sol.distance[visit.vertex] = sol.epoch + visit.depth;
+    sol.parent[visit.vertex]   = visit.parent;
+    max_depth                  = std::max(max_depth, visit.depth);
+  }
+
+  sol.next_epoch = sol.epoch + max_depth + 1;
+}
+
+/**
+ * @brief Local query from source_node for small-radius traversals on huge
+ * graphs. While the frontiers stay small, the traversal runs serially with the
+ * visited vertices in a VisitedSet and visits doubling as the queue, so it
+ * costs the edges it touches and nothing per vertex of the graph. Once the
+ * edges of a frontier exceed threshold, n / 64 by default, the vertices
+ * reached so far seed sol and the rest runs as a dense hybrid traversal.
+ *
+ * visits gets every reached vertex with its depth and parent. Returns whether
+ * the query went dense, sol holds the full result then.
+ */
+template <Backend B = Backend::kOpenMP, Graph GraphT>
+inline bool BfsLocal(const GraphT &G, typename GraphT::vertex_type source_node,
+                     VisitsOf<GraphT> &visits, SolutionOf<GraphT> &sol,
+                     WorkspaceOf<GraphT> &ws, std::size_t threshold = 0) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  const std::size_t n = G.get_num_nodes();
+  if (threshold == 0) threshold = std::max<std::size_t>(n / 64, 1024);
+
+  VisitedSet<vertex_type> visited;
+  visits.clear();
+  visits.push_back({source_node, 0, NOT_VISITED});
+  visited.insert(source_node);
+
+  std::size_t num_checked_edges = 0;
+  std::size_t level_begin       = 0;
+  int         depth             = 0;
+  while (level_begin != visits.size()) {
+    const std::size_t level_end = visits.size();
+
+    std::size_t m_f = 0;
+    for (std::size_t i = level_begin; i < level_end; ++i)
+      m_f += G.get_num_edges(visits[i].vertex);
+    if (m_f > threshold) break;
+
+    for (std::size_t i = level_begin; i < level_end; ++i) {
+      const vertex_type u = visits[i].vertex;
+      for (const vertex_type v : G.neighbors(u))
+        if (visited.insert(v)) visits.push_back({v, depth + 1, u});
+    }
+
+    num_checked_edges += m_f;
+
+    level_begin = level_end;
+    ++depth;
+  }
+
+  if (level_begin == visits.size()) return false;
+
+  // seed the dense arrays, the last level becomes the frontier
+  ScatterVisits(visits, n, source_node, sol);
+
+  ws.prepare(n);
+  ws.frontier.clear();
+  for (std::size_t i = level_begin; i < visits.size(); ++i)
+    ws.frontier.push_back(visits[i].vertex);
+
+  BfsHybridFrom<B>(G, sol, ws, depth, num_checked_edges);
+  CollectVisits(sol, visits);
+  return true;
+}
+
+/**
+ * @brief Limits of a bounded traversal, the defaults leave it unbounded
+ */
+struct BfsLimits {
+  int         max_depth{std::numeric_limits<int>::max()};
+  std::size_t max_vertices{std::numeric_limits<std::size_t>::max()};
+};
+
+/**
+ * @brief Traversal from source_node that stops at max_depth, for k-hop
+ * neighborhoods, or once max_vertices vertices including the source are
+ * discovered, for the k nearest ones. visits gets exactly the discovered
+ * vertices in BFS order. Nothing sized by the graph is touched, so a lookup
+ * costs the edges it scans. Returns the number of checked edges.
+ */
+template <Graph GraphT>
+inline std::size_t BfsBounded(const GraphT                &G,
+                              typename GraphT::vertex_type source_node,
+                              const BfsLimits             &limits,
+                              VisitsOf<GraphT>            &visits) {
+  using vertex_type = typename GraphT::vertex_type;
+
+  visits.clear();
+  if (limits.max_vertices == 0) return 0;
+
+  VisitedSet<vertex_type> visited;
+  visits.push_back({source_node, 0, NOT_VISITED});
+  visited.insert(source_node);
+  if (visits.size() >= limits.max_vertices) return 0;
+
+  std::size_t num_checked_edges = 0;
+  std::size_t level_begin       = 0;
+  for (int depth = 0; depth < limits.max_depth; ++depth) {
+    const std::size_t level_end = visits.size();
+    if (level_begin == level_end) break;
+
+    for (std::size_t i = level_begin; i < level_end; ++i) {
+      const vertex_type u = visits[i].vertex;
+      for (const vertex_type v : G.neighbors(u)) {
+        ++num_checked_edges;
+        if (!visited.insert(v)) continue;
+        visits.push_back({v, depth + 1, u});
+        if (visits.size() >= limits.max_vertices) return num_checked_edges;
+      }
+    }
+
+    level_begin = level_end;
+  }
+
+  return num_checked_edges;
+}
@@ -1,57 +1,69 @@
 EXEC=./bfs
+CONVERT=./bfs-convert
+make bfs bfs-convert || exit 1
+
+# the SNAP edge lists in graph/ are converted once into undirected binary
+# graphs without repeated edges, sources are given as the original ids
+graphs=('web-Stanford' 'roadNet-CA' 'soc-LiveJournal1' 'com-orkut.ungraph'
+  'RMAT1' 'RMAT2' 'RMAT3')
+for graph in "${graphs[@]}"; do
+  if [[ ! -e "graph/$graph.bin" ]]; then
+    $CONVERT graph/$graph.txt graph/$graph.bin --symmetrize --dedup || exit 1
+  fi
+done
 for ((i = 1; i <= 10; i++)); do
   target=result/web-Stanford-$i-1-0.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/web-Stanford.mm 1 0 | tee $target
+    $EXEC $i graph/web-Stanford.bin 1 0 --ids=graph/web-Stanford.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/web-Stanford-$i-1-2.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/web-Stanford.mm 1 2 | tee $target
+    $EXEC $i graph/web-Stanford.bin 1 2 --ids=graph/web-Stanford.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/roadNet-CA-$i-1-0.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/roadNet-CA.mm 1 0 | tee $target
+    $EXEC $i graph/roadNet-CA.bin 1 0 --ids=graph/roadNet-CA.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/roadNet-CA-$i-1-2.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/roadNet-CA.mm 1 2 | tee $target
+    $EXEC $i graph/roadNet-CA.bin 1 2 --ids=graph/roadNet-CA.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/soc-LiveJournal1-$i-1-0.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/soc-LiveJournal1.mm 1 0 | tee $target
+    $EXEC $i graph/soc-LiveJournal1.bin 1 0 --ids=graph/soc-LiveJournal1.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/soc-LiveJournal1-$i-1-2.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/soc-LiveJournal1.mm 1 2 | tee $target
+    $EXEC $i graph/soc-LiveJournal1.bin 1 2 --ids=graph/soc-LiveJournal1.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/com-orkut-$i-1-0.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/com-orkut.ungraph.txt 1 0 | tee $target
+    $EXEC $i graph/com-orkut.ungraph.bin 1 0 --ids=graph/com-orkut.ungraph.ids | tee $target
   fi
 done
 
 for ((i = 1; i <= 10; i++)); do
   target=result/com-orkut-$i-1-2.txt
   if [[ ! -e "$target" ]]; then
-    $EXEC $i graph/com-orkut.ungraph.txt 1 2 | tee $target
+    $EXEC $i graph/com-orkut.ungraph.bin 1 2 --ids=graph/com-orkut.ungraph.ids | tee $target
   fi
 done
 
@@ -59,14 +71,14 @@ for ((k = 1; k <= 3; k++)); do
   for ((i = 1; i <= 10; i++)); do
     target=result/RMAT$k-$i-1-0.txt
     if [[ ! -e "$target" ]]; then
-      $EXEC $i graph/RMAT$k.txt 1 0 | tee $target
+      $EXEC $i graph/RMAT$k.bin 1 0 --ids=graph/RMAT$k.ids | tee $target
     fi
   done
 
   for ((i = 1; i <= 10; i++)); do
     target=result/RMAT$k-$i-1-2.txt
     if [[ ! -e "$target" ]]; then
-      $EXEC $i graph/RMAT$k.txt 1 2 | tee $target
+      $EXEC $i graph/RMAT$k.bin 1 2 --ids=graph/RMAT$k.ids | tee $target
     fi
   done
 done
@@ -78,7 +90,7 @@ for top_down in "${is_top_down[@]}"; do
     for ((i = 1; i <= 10; i++)); do
       target=result/web-Stanford-$i-$k-$top_down.txt
       if [[ ! -e "$target" ]]; then
-        $EXEC $i graph/web-Stanford.mm $k $top_down | tee $target
+        $EXEC $i graph/web-Stanford.bin $k $top_down --ids=graph/web-Stanford.ids | tee $target
       fi
     done
   done
@@ -89,7 +101,7 @@ for top_down in "${is_top_down[@]}"; do
     for ((i = 1; i <= 10; i++)); do
       target=result/roadNet-CA-$i-$k-$top_down.txt
       if [[ ! -e "$target" ]]; then
-        $EXEC $i graph/roadNet-CA.mm $k $top_down | tee $target
+        $EXEC $i graph/roadNet-CA.bin $k $top_down --ids=graph/roadNet-CA.ids | tee $target
       fi
     done
   done
@@ -100,7 +112,7 @@ for top_down in "${is_top_down[@]}"; do
     for ((i = 1; i <= 10; i++)); do
       target=result/soc-LiveJournal1-$i-$k-$top_down.txt
       if [[ ! -e "$target" ]]; then
-        $EXEC $i graph/soc-LiveJournal1.mm $k $top_down | tee $target
+        $EXEC $i graph/soc-LiveJournal1.bin $k $top_down --ids=graph/soc-LiveJournal1.ids | tee $target
       fi
     done
   done
@@ -111,8 +123,27 @@ for top_down in "${is_top_down[@]}"; do
     for ((i = 1; i <= 10; i++)); do
       target=result/com-orkut-$i-$k-$top_down.txt
       if [[ ! -e "$target" ]]; then
-        $EXEC $i graph/com-orkut.ungraph.txt $k $top_down | tee $target
+        $EXEC $i graph/com-orkut.ungraph.bin $k $top_down --ids=graph/com-orkut.ungraph.ids | tee $target
       fi
     done
   done
 done
+
+# TBB backend against the OpenMP schedule(dynamic, 128) runs above, on the
+# skewed graphs and the road graph, results under the same names in result/tbb
+mkdir -p result/tbb
+tbb_graphs=('web-Stanford' 'roadNet-CA' 'soc-LiveJournal1' 'com-orkut.ungraph')
+for graph in "${tbb_graphs[@]}"; do
+  name=${graph%.ungraph}
+  for top_down in "${is_top_down[@]}"; do
+    for ((k = 1; k <= 8; k++)); do
+      for ((i = 1; i <= 10; i++)); do
+        target=result/tbb/$name-$i-$k-$top_down.txt
+        if [[ ! -e "$target" ]]; then
+          $EXEC $i graph/$graph.bin $k $top_down --ids=graph/$graph.ids \
+            --backend=tbb | tee $target
+        fi
+      done
+    done
+  done
+done
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+# Distances and shortest paths of the bidirectional search (--target) against
+# the depths of a full traversal
+
+EXEC=$(dirname "$0")/bfs
+graph=$(mktemp --suffix=.txt)
+path=$(mktemp)
+trap 'rm -f $graph $path' EXIT
+
+# 300 vertices, a ring of chords over 0..249 and a separate path over 280..299
+awk 'BEGIN {
+  for (i = 0; i < 250; i++) print i, (i * 17 + 5) % 250
+  for (i = 0; i < 250; i += 3) print i, (i + 1) % 250
+  for (i = 280; i < 299; i++) print i, i + 1
+}' >$graph
+
+status=0
+check() {
+  local s=$1 t=$2 flags=$3
+  local want got
+  want=$($EXEC $s $graph 1 2 $flags --print | grep -v '^%' | tail -n +2 |
+    awk -v t=$t '$1 == t { print $2 }')
+  $EXEC $s $graph 1 2 $flags --target=$t --print | grep -v '^%' >$path
+  got=$(head -n 1 $path | cut -d' ' -f2)
+  if [[ "$got" != "$want" ]]; then
+    echo "$s -> $t $flags: got distance $got want $want"
+    status=1
+    return
+  fi
+
+  # distance + 1 vertices from s to t, every step along an edge of the graph
+  tail -n +2 $path | awk -v s=$s -v t=$t -v d=$want -v directed="$flags" '
+    NR == FNR { edge[$1 " " $2] = 1; if (!directed) edge[$2 " " $1] = 1; next }
+    { v[n++] = $1 }
+    END {
+      if (d == -1) exit n != 0
+      if (n != d + 1 || v[0] != s || v[n - 1] != t) exit 1
+      for (i = 1; i < n; i++) if (!((v[i - 1] " " v[i]) in edge)) exit 1
+    }' $graph -
+  if [[ $? != 0 ]]; then
+    echo "$s -> $t $flags: not a shortest path"
+    status=1
+  fi
+}
+
+for flags in "" --directed; do
+  check 0 0 "$flags"
+  check 0 1 "$flags"
+  check 0 249 "$flags"
+  check 7 123 "$flags"
+  check 200 13 "$flags"
+  check 280 299 "$flags"
+  check 299 280 "$flags"
+  check 5 290 "$flags"
+  check 260 3 "$flags"
+done
+
+if [[ $status == 0 ]]; then
+  echo "check passed"
+else
+  echo "check not passed"
+fi
+exit $status
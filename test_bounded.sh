@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+# Edge cases of the bounded traversals, khop and nearest of bfs-server
+
+SERVER=$(dirname "$0")/bfs-server
+graph=$(mktemp --suffix=.txt)
+trap 'rm -f $graph' EXIT
+
+# a star around 0 with a tail 0 - 1 - 2 - 3
+printf '0 1\n1 2\n2 3\n0 4\n0 5\n' >$graph
+
+status=0
+check() {
+  local request=$1 want=$2
+  local got
+  got=$(echo "$request" | $SERVER 1 g=$graph 2>/dev/null | cut -d' ' -f3)
+  if [[ "$got" != "$want" ]]; then
+    echo "$request: got $got want $want"
+    status=1
+  fi
+}
+
+check "nearest g 0 0" 0
+check "nearest g 0 1" 1
+check "nearest g 0 2" 2
+check "nearest g 0 100" 6
+check "khop g 0 0" 1
+check "khop g 0 1" 4
+check "khop g 0 2" 5
+check "khop g 3 0" 1
+
+if [[ $status == 0 ]]; then
+  echo "check passed"
+else
+  echo "check not passed"
+fi
+exit $status
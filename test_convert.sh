@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+# Original vertex ids through bfs-convert: traversals of the converted .bin
+# and .cbin graphs with --ids against the same graph on dense ids
+
+DIR=$(dirname "$0")
+EXEC=$DIR/bfs
+CONVERT=$DIR/bfs-convert
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+
+# 300 vertices on dense ids, and the same edges on sparse ids past 2^32 that
+# keep the order of the dense ones
+awk 'BEGIN {
+  for (i = 0; i < 300; i++) print i, (i * 17 + 5) % 300
+  for (i = 0; i < 300; i += 3) print i, (i + 1) % 300
+}' >$work/dense.txt
+awk '{ printf "%.0f %.0f\n", $1 * 1000003 + 5e9, $2 * 1000003 + 5e9 }' \
+  $work/dense.txt >$work/sparse.txt
+
+status=0
+check() {
+  local name=$1 file=$2 flags=$3 s=$4
+  local want got
+  want=$($EXEC $s $work/dense.txt 1 2 $flags --print | grep -v '^%' |
+    tail -n +2 | awk '{ printf "%.0f %d\n", $1 * 1000003 + 5e9, $2 }')
+  got=$($EXEC $((s * 1000003 + 5000000000)) $file 1 2 --ids=${file%.*}.ids \
+    --print | grep -v '^%' | tail -n +2)
+  if [[ "$got" != "$want" ]]; then
+    echo "$name from $s: depths differ"
+    status=1
+  fi
+}
+
+for flags in "" --directed; do
+  symmetrize=$([[ -z "$flags" ]] && echo --symmetrize)
+  $CONVERT $work/sparse.txt $work/graph.bin $symmetrize >/dev/null || status=1
+  $CONVERT $work/sparse.txt $work/graph.cbin $symmetrize >/dev/null || status=1
+
+  # the id file lists the original ids in dense order
+  want=$(seq 0 299 | awk '{ printf "%.0f\n", $1 * 1000003 + 5e9 }')
+  got=$(od -An -tu8 -v -w8 $work/graph.ids | tr -d ' ')
+  if [[ "$got" != "$want" ]]; then
+    echo "ids $flags: not the original ids in dense order"
+    status=1
+  fi
+
+  for s in 0 7 150 299; do
+    check "bin $flags" $work/graph.bin "$flags" $s
+    check "cbin $flags" $work/graph.cbin "$flags" $s
+  done
+done
+
+if [[ $status == 0 ]]; then
+  echo "check passed"
+else
+  echo "check not passed"
+fi
+exit $status
@@ -0,0 +1,113 @@
+#!/usr/bin/env bash
+# Status codes and results of the C ABI of libbfs, from a C program linked
+# against libbfs.a
+
+DIR=$(dirname "$0")
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+
+printf 'not a graph\n' >$work/bad.bin
+printf '0 1\n1 2\n2 3\n0 4\n' >$work/path.txt
+
+cat >$work/test.c <<'EOF'
+#include <stdio.h>
+
+#include "libbfs.h"
+
+static int status = 0;
+
+static void check(const char *what, long got, long want) {
+  if (got == want) return;
+  printf("%s: got %ld want %ld\n", what, got, want);
+  status = 1;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  const char *bad_file  = argv[1];
+  const char *path_file = argv[2];
+
+  bfs_graph  *graph = NULL;
+  bfs_options options;
+  bfs_options_init(&options);
+
+  check("load of a missing file",
+        bfs_graph_load("/nonexistent.txt", 0, &graph), BFS_ERROR_IO);
+  check("load of a malformed file", bfs_graph_load(bad_file, 0, &graph),
+        BFS_ERROR_IO);
+  check("load without a handle", bfs_graph_load(path_file, 0, NULL),
+        BFS_ERROR_ARGUMENT);
+  check("run without a graph", bfs_run(NULL, 0, &options, NULL, NULL),
+        BFS_ERROR_ARGUMENT);
+
+  const int64_t src[] = {0, 1, 2};
+  const int64_t dst[] = {1, 2, 5};
+  check("edge past num_nodes", bfs_graph_from_edges(4, src, dst, 3, 0, &graph),
+        BFS_ERROR_ARGUMENT);
+
+  /* 0 - 1 - 2 - 3 - 4 and 5 alone */
+  const int64_t path_src[] = {0, 1, 2, 3};
+  const int64_t path_dst[] = {1, 2, 3, 4};
+  check("graph from edges",
+        bfs_graph_from_edges(6, path_src, path_dst, 4, 0, &graph), BFS_OK);
+  if (graph == NULL) return 1;
+  check("num_nodes", bfs_graph_num_nodes(graph), 6);
+
+  int32_t depths[6], parents[6];
+  check("source past num_nodes", bfs_run(graph, 6, &options, depths, parents),
+        BFS_ERROR_ARGUMENT);
+  check("negative source", bfs_run(graph, -1, &options, depths, parents),
+        BFS_ERROR_ARGUMENT);
+
+  options.method = 42;
+  check("unknown method", bfs_run(graph, 0, &options, depths, parents),
+        BFS_ERROR_ARGUMENT);
+
+  bfs_options old_options = options;
+  old_options.size        = 4;
+  check("options of another size",
+        bfs_run(graph, 0, &old_options, depths, parents), BFS_ERROR_ARGUMENT);
+
+  const int32_t want_depths[]  = {2, 1, 0, 1, 2, -1};
+  const int32_t want_parents[] = {1, 2, -1, 2, 3, -1};
+  for (int method = BFS_TOP_DOWN; method <= BFS_PERSISTENT; ++method) {
+    options.method = method;
+    check("run", bfs_run(graph, 2, &options, depths, parents), BFS_OK);
+    for (int v = 0; v < 6; ++v) {
+      check("depth", depths[v], want_depths[v]);
+      check("parent", parents[v], want_parents[v]);
+    }
+  }
+
+  check("run without output buffers", bfs_run(graph, 2, NULL, NULL, NULL),
+        BFS_OK);
+  bfs_graph_free(graph);
+
+  /* the text formats are symmetrized unless directed */
+  graph = NULL;
+  check("load", bfs_graph_load(path_file, 0, &graph), BFS_OK);
+  if (graph == NULL) return 1;
+  check("loaded num_edges", bfs_graph_num_edges(graph), 8);
+  check("run on the loaded graph", bfs_run(graph, 4, NULL, depths, NULL),
+        BFS_OK);
+  check("depth of 3", depths[3], 4);
+  bfs_graph_free(graph);
+
+  return status;
+}
+EOF
+
+status=0
+if ! gcc -std=c11 -Wall -Wextra -I$DIR -o $work/test $work/test.c \
+  $DIR/libbfs.a -lstdc++ -fopenmp -ltbb -ltbbmalloc; then
+  status=1
+elif ! $work/test $work/bad.bin $work/path.txt; then
+  status=1
+fi
+
+if [[ $status == 0 ]]; then
+  echo "check passed"
+else
+  echo "check not passed"
+fi
+exit $status
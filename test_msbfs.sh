@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# Per-source statistics of MS-BFS (--batch) and of the concurrent batches
+# (--batch --concurrent) against one hybrid traversal per source
+
+EXEC=$(dirname "$0")/bfs
+graph=$(mktemp --suffix=.txt)
+trap 'rm -f $graph' EXIT
+
+# 300 vertices, a ring of chords over 0..249 and a separate path over 280..299
+awk 'BEGIN {
+  for (i = 0; i < 250; i++) print i, (i * 17 + 5) % 250
+  for (i = 0; i < 250; i += 3) print i, (i + 1) % 250
+  for (i = 280; i < 299; i++) print i, i + 1
+}' >$graph
+
+# 70 sources span two batches of 64 lanes, some start in the separate path
+source=250
+batch=70
+
+status=0
+check() {
+  local name=$1 flags=$2
+  local want got
+  want=$(for ((i = 0; i < batch; i++)); do
+    s=$(((source + i) % 300))
+    $EXEC $s $graph 1 2 $flags --print | grep -v '^%' | tail -n +2 |
+      awk -v s=$s '$2 != -1 { n++; sum += $2; if ($2 > ecc) ecc = $2 }
+        END { print s, n, sum + 0, ecc + 0 }'
+  done)
+
+  got=$($EXEC $source $graph 1 2 $flags --batch=$batch --print |
+    grep -v '^%' | tail -n +2)
+  if [[ "$got" != "$want" ]]; then
+    echo "$name $flags: batch statistics differ"
+    status=1
+  fi
+
+  got=$($EXEC $source $graph 1 2 $flags --batch=$batch --concurrent --print |
+    grep -v '^%' | tail -n +2)
+  if [[ "$got" != "$want" ]]; then
+    echo "$name $flags: concurrent statistics differ"
+    status=1
+  fi
+}
+
+check undirected ""
+check directed --directed
+
+if [[ $status == 0 ]]; then
+  echo "check passed"
+else
+  echo "check not passed"
+fi
+exit $status